@@ -0,0 +1,42 @@
+// MIT License
+// Copyright (c) 2025 David White
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// The box (collider) data shared by the collider manager and the broadphase structures
+
+#pragma once
+
+#include <DirectXMath.h>
+
+using namespace DirectX;
+
+constexpr float minX = -10.0f;
+constexpr float maxX = 30.0f;
+constexpr float minZ = -30.0f;
+constexpr float maxZ = 30.0f;
+constexpr float box_offset = 10.0f;
+constexpr float minY = 0.0f; // the floor
+constexpr float maxY = box_offset + 1.0f; // boxes are dropped from no higher than this
+
+constexpr float box_scale = 0.25;
+
+constexpr float gravity = -9.8f;
+
+struct  Box {
+    XMFLOAT4 positionAndRadius; // this might seem odd, but this method is explicit in the packing for hlsl
+    XMFLOAT4 velocity; // this only needs to be 3, but to avoid HLSL packing errors 4 is again explicit
+};
+
+struct CollisionPair {
+    unsigned int index1;
+    unsigned int index2;
+};
@@ -0,0 +1,76 @@
+#include "BoxSlotMap.h"
+
+void BoxSlotMap::clear()
+{
+	for (const unsigned int slot : m_slotOf)
+		freeSlot(slot);
+	m_slotOf.clear();
+}
+
+void BoxSlotMap::reserve(const unsigned int capacity)
+{
+	m_slots.reserve(capacity);
+	m_slotOf.reserve(capacity);
+}
+
+BoxHandle BoxSlotMap::insert()
+{
+	unsigned int slot = m_freeList;
+	if (slot == removed_box)
+	{
+		slot = (unsigned int)m_slots.size();
+		m_slots.push_back({ 0, 0 });
+	}
+	else
+	{
+		m_freeList = m_slots[slot].index;
+	}
+
+	m_slots[slot].index = (unsigned int)m_slotOf.size();
+	m_slotOf.push_back(slot);
+	return { slot, m_slots[slot].generation };
+}
+
+unsigned int BoxSlotMap::erase(const BoxHandle handle)
+{
+	const unsigned int index = indexOf(handle);
+	if (index == removed_box)
+		return removed_box;
+
+	// the last box takes the removed box's place
+	const unsigned int lastSlot = m_slotOf.back();
+	m_slotOf[index] = lastSlot;
+	m_slots[lastSlot].index = index;
+	m_slotOf.pop_back();
+
+	freeSlot(handle.slot);
+	return index;
+}
+
+void BoxSlotMap::reorder(const unsigned int* order, const unsigned int count)
+{
+	// the slots of any boxes being dropped are found by marking the ones that are kept
+	m_reorderedSlots.resize(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		const unsigned int slot = m_slotOf[order[i]];
+		m_reorderedSlots[i] = slot;
+		m_slotOf[order[i]] = removed_box;
+	}
+	for (const unsigned int slot : m_slotOf)
+	{
+		if (slot != removed_box)
+			freeSlot(slot);
+	}
+
+	m_slotOf.swap(m_reorderedSlots);
+	for (unsigned int i = 0; i < count; i++)
+		m_slots[m_slotOf[i]].index = i;
+}
+
+void BoxSlotMap::freeSlot(const unsigned int slot)
+{
+	m_slots[slot].generation++;
+	m_slots[slot].index = m_freeList;
+	m_freeList = slot;
+}
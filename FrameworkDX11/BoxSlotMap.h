@@ -0,0 +1,80 @@
+// MIT License
+// Copyright (c) 2025 David White
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+
+// Stable handles to the boxes in a BoxStore, which keeps them packed (and reorders them) so they can't be found by index
+// A handle names a slot, and each slot holds the box's index in the store and a generation that goes up every time its
+// box is removed - so a handle to a box that has gone is caught rather than finding whichever box took its slot.
+// Adding and removing are O(1): a new box goes on the end, and a removed box has the last box moved in to its place,
+// so the boxes stay dense for the loops that go through all of them. Freed slots are reused, newest first.
+
+#pragma once
+
+#include <vector>
+#include "BoxStore.h"
+
+using namespace std;
+
+struct BoxHandle {
+    unsigned int slot = removed_box;
+    unsigned int generation = 0;
+};
+
+class BoxSlotMap
+{
+public:
+    BoxSlotMap() = default;
+
+    unsigned int size() const { return (unsigned int)m_slotOf.size(); }
+
+    // removes every box - their handles all become stale
+    void clear();
+    void reserve(const unsigned int capacity);
+
+    // a handle for a new box at index size() in the store
+    BoxHandle insert();
+    // the box's index before it was removed, so the store can do the same - the last box moves in to that index
+    // (unless it was the last box). removed_box if the handle is stale.
+    unsigned int erase(const BoxHandle handle);
+
+    // the index of the handle's box in the store, or removed_box if the handle is stale
+    unsigned int indexOf(const BoxHandle handle) const
+    {
+        if (handle.slot >= m_slots.size() || m_slots[handle.slot].generation != handle.generation)
+            return removed_box;
+        return m_slots[handle.slot].index;
+    }
+
+    BoxHandle handleAt(const unsigned int index) const
+    {
+        const unsigned int slot = m_slotOf[index];
+        return { slot, m_slots[slot].generation };
+    }
+
+    // the same as BoxStore::reorder - box i becomes the box that was at order[i], and any box not in order is removed
+    void reorder(const unsigned int* order, const unsigned int count);
+
+private:
+    struct Slot {
+        unsigned int index; // the box's index in the store, or the next free slot when the slot is free
+        unsigned int generation;
+    };
+
+    void freeSlot(const unsigned int slot);
+
+private:
+    vector<Slot>            m_slots;
+    vector<unsigned int>    m_slotOf; // the slot of the box at each index in the store
+    vector<unsigned int>    m_reorderedSlots; // reorder builds the new m_slotOf in this
+    unsigned int            m_freeList = removed_box;
+};
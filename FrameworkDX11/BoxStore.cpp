@@ -0,0 +1,64 @@
+#include "BoxStore.h"
+
+void BoxStore::clear()
+{
+	m_x.clear();
+	m_y.clear();
+	m_z.clear();
+	m_radius.clear();
+	m_vx.clear();
+	m_vy.clear();
+	m_vz.clear();
+}
+
+void BoxStore::push_back(const Box& box)
+{
+	m_x.push_back(box.positionAndRadius.x);
+	m_y.push_back(box.positionAndRadius.y);
+	m_z.push_back(box.positionAndRadius.z);
+	m_radius.push_back(box.positionAndRadius.w);
+	m_vx.push_back(box.velocity.x);
+	m_vy.push_back(box.velocity.y);
+	m_vz.push_back(box.velocity.z);
+}
+
+void BoxStore::removeSwap(const unsigned int i)
+{
+	AlignedVector<float>* arrays[] = { &m_x, &m_y, &m_z, &m_radius, &m_vx, &m_vy, &m_vz };
+	for (AlignedVector<float>* values : arrays)
+	{
+		(*values)[i] = values->back();
+		values->pop_back();
+	}
+}
+
+// One array at a time, so there is only ever one array's worth of scratch
+void BoxStore::reorder(const unsigned int* order, const unsigned int count)
+{
+	AlignedVector<float>* arrays[] = { &m_x, &m_y, &m_z, &m_radius, &m_vx, &m_vy, &m_vz };
+	m_scratch.resize(count);
+	for (AlignedVector<float>* values : arrays)
+	{
+		const float* source = values->data();
+		for (unsigned int i = 0; i < count; i++)
+			m_scratch[i] = source[order[i]];
+		values->swap(m_scratch);
+		m_scratch.resize(count);
+	}
+}
+
+BoxArrays BoxStore::arrays()
+{
+	return { m_x.data(), m_y.data(), m_z.data(), m_radius.data(), m_vx.data(), m_vy.data(), m_vz.data() };
+}
+
+// Written straight in to the mapped staging buffer, so there is no AoS copy kept on the CPU
+void BoxStore::packBoxes(Box* output) const
+{
+	const unsigned int count = size();
+	for (unsigned int i = 0; i < count; i++)
+	{
+		output[i].positionAndRadius = XMFLOAT4(m_x[i], m_y[i], m_z[i], m_radius[i]);
+		output[i].velocity = XMFLOAT4(m_vx[i], m_vy[i], m_vz[i], 0.0f);
+	}
+}
@@ -0,0 +1,118 @@
+// MIT License
+// Copyright (c) 2025 David White
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+
+// The boxes as a structure of arrays - the x, y and z of the positions and velocities, and the radii, each in an array
+// The collision checks only read the positions and radii, so they no longer drag the velocities through the cache
+// with them (half of every line they fetched), and the row kernels read the arrays where they are rather than from a
+// copy. The compute shader still reads Box structs, so packBoxes interleaves them again for the upload.
+
+#pragma once
+
+#include <DirectXMath.h>
+#include "Box.h"
+#include "AlignedAllocator.h"
+
+using namespace DirectX;
+
+// In a remapping of box indices (where each box has moved to), for a box that has been taken away
+constexpr unsigned int removed_box = 0xFFFFFFFF;
+
+// Pointers in to a BoxStore's arrays, for the kernels that move the boxes or change their velocities
+struct BoxArrays {
+    float*  x;
+    float*  y;
+    float*  z;
+    float*  radius;
+    float*  vx;
+    float*  vy;
+    float*  vz;
+};
+
+class BoxStore;
+
+// One box in a BoxStore, read only - what ColliderManager::getBox hands out, now there is no Box to point at
+class BoxView
+{
+public:
+    BoxView() = default;
+    BoxView(const BoxStore* store, const unsigned int index) : m_store(store), m_index(index) {}
+
+    bool isValid() const { return m_store != nullptr; }
+
+    XMFLOAT3 position() const;
+    float radius() const;
+    XMFLOAT3 velocity() const;
+
+private:
+    const BoxStore* m_store = nullptr;
+    unsigned int    m_index = 0;
+};
+
+class BoxStore
+{
+public:
+    BoxStore() = default;
+
+    unsigned int size() const { return (unsigned int)m_x.size(); }
+    bool empty() const { return m_x.empty(); }
+
+    void clear();
+    void push_back(const Box& box);
+    // the last box moves in to i, so the rest stay where they are
+    void removeSwap(const unsigned int i);
+    // box i becomes the box that was at order[i], for i in [0, count) - any box not in order is dropped
+    void reorder(const unsigned int* order, const unsigned int count);
+
+    BoxView view(const unsigned int i) const { return BoxView(this, i); }
+    XMFLOAT4 positionAndRadius(const unsigned int i) const { return XMFLOAT4(m_x[i], m_y[i], m_z[i], m_radius[i]); }
+
+    const float* x() const { return m_x.data(); }
+    const float* y() const { return m_y.data(); }
+    const float* z() const { return m_z.data(); }
+    const float* radius() const { return m_radius.data(); }
+    const float* vx() const { return m_vx.data(); }
+    const float* vy() const { return m_vy.data(); }
+    const float* vz() const { return m_vz.data(); }
+
+    BoxArrays arrays();
+
+    // interleave boxes [0, size()) back in to Box structs, for the compute shader's buffer
+    void packBoxes(Box* output) const;
+
+private:
+    AlignedVector<float> m_x;
+    AlignedVector<float> m_y;
+    AlignedVector<float> m_z;
+    AlignedVector<float> m_radius;
+    AlignedVector<float> m_vx;
+    AlignedVector<float> m_vy;
+    AlignedVector<float> m_vz;
+    AlignedVector<float> m_scratch; // reorder gathers each array in to this, then swaps it in
+};
+
+inline XMFLOAT3 BoxView::position() const
+{
+    const XMFLOAT4 p = m_store->positionAndRadius(m_index);
+    return XMFLOAT3(p.x, p.y, p.z);
+}
+
+inline float BoxView::radius() const
+{
+    return m_store->radius()[m_index];
+}
+
+inline XMFLOAT3 BoxView::velocity() const
+{
+    return XMFLOAT3(m_store->vx()[m_index], m_store->vy()[m_index], m_store->vz()[m_index]);
+}
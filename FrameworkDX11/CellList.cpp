@@ -0,0 +1,199 @@
+#include "CellList.h"
+#include <algorithm>
+#include <cmath>
+
+void CellList::build(const BoxStore& boxes, ThreadPool& threadPool, const float skin)
+{
+	const unsigned int numBoxes = boxes.size();
+	const unsigned int numJobs = std::max(threadPool.threadCount(), 1u); // at least one, or a pool with no workers would leave the cells stale
+
+	m_jobMaxRadius.resize(numJobs);
+	m_jobTotals.resize(numJobs);
+	m_boxCell.resize(numBoxes);
+	m_sortedBoxes.resize(numBoxes);
+
+	// 1. the cells must be at least as wide as the biggest box (plus the skin), so overlapping boxes are never more than a cell apart
+	threadPool.runJobs(numJobs, [&](const unsigned int job) {
+		unsigned int begin, end;
+		ThreadPool::jobRange(numBoxes, numJobs, job, begin, end);
+		float maxRadius = box_scale;
+		for (unsigned int i = begin; i < end; i++)
+			maxRadius = std::max(maxRadius, boxes.radius()[i]);
+		m_jobMaxRadius[job] = maxRadius;
+		});
+
+	m_skin = skin;
+	m_cellSize = 2.0f * *std::max_element(m_jobMaxRadius.begin(), m_jobMaxRadius.end()) + skin;
+	m_invCellSize = 1.0f / m_cellSize;
+	m_dimX = std::max(1, (int)std::ceil((maxX - minX) * m_invCellSize));
+	m_dimY = std::max(1, (int)std::ceil((maxY - minY) * m_invCellSize));
+	m_dimZ = std::max(1, (int)std::ceil((maxZ - minZ) * m_invCellSize));
+	m_numCells = m_dimX * m_dimY * m_dimZ;
+
+	if (m_cellCapacity < m_numCells)
+	{
+		m_cellCapacity = m_numCells;
+		m_cellCounts.reset(new atomic<unsigned int>[m_cellCapacity]);
+	}
+	m_cellStart.resize(m_numCells + 1);
+
+	// 2. clear the counts
+	threadPool.runJobs(numJobs, [&](const unsigned int job) {
+		unsigned int begin, end;
+		ThreadPool::jobRange(m_numCells, numJobs, job, begin, end);
+		for (unsigned int c = begin; c < end; c++)
+			m_cellCounts[c].store(0, memory_order_relaxed);
+		});
+
+	// 3. find each box's cell and count it
+	threadPool.runJobs(numJobs, [&](const unsigned int job) {
+		unsigned int begin, end;
+		ThreadPool::jobRange(numBoxes, numJobs, job, begin, end);
+		for (unsigned int i = begin; i < end; i++)
+		{
+			const XMFLOAT4 p = boxes.positionAndRadius(i);
+			const unsigned int cell = getCellIndex(cellCoord(p.x, minX, m_dimX), cellCoord(p.y, minY, m_dimY), cellCoord(p.z, minZ, m_dimZ));
+			m_boxCell[i] = cell;
+			m_cellCounts[cell].fetch_add(1, memory_order_relaxed);
+		}
+		});
+
+	// 4. exclusive prefix sum of the counts - each job sums its block, the block totals are scanned,
+	// then each job scans its block again starting from its block's offset
+	threadPool.runJobs(numJobs, [&](const unsigned int job) {
+		unsigned int begin, end;
+		ThreadPool::jobRange(m_numCells, numJobs, job, begin, end);
+		unsigned int sum = 0;
+		for (unsigned int c = begin; c < end; c++)
+			sum += m_cellCounts[c].load(memory_order_relaxed);
+		m_jobTotals[job] = sum;
+		});
+
+	unsigned int offset = 0;
+	for (unsigned int& total : m_jobTotals)
+	{
+		const unsigned int t = total;
+		total = offset;
+		offset += t;
+	}
+
+	threadPool.runJobs(numJobs, [&](const unsigned int job) {
+		unsigned int begin, end;
+		ThreadPool::jobRange(m_numCells, numJobs, job, begin, end);
+		unsigned int sum = m_jobTotals[job];
+		for (unsigned int c = begin; c < end; c++)
+		{
+			const unsigned int count = m_cellCounts[c].load(memory_order_relaxed);
+			m_cellStart[c] = sum;
+			m_cellCounts[c].store(sum, memory_order_relaxed); // now the write cursor for the scatter
+			sum += count;
+		}
+		});
+	m_cellStart[m_numCells] = numBoxes;
+
+	// 5. scatter the box indices in to their cells
+	threadPool.runJobs(numJobs, [&](const unsigned int job) {
+		unsigned int begin, end;
+		ThreadPool::jobRange(numBoxes, numJobs, job, begin, end);
+		for (unsigned int i = begin; i < end; i++)
+			m_sortedBoxes[m_cellCounts[m_boxCell[i]].fetch_add(1, memory_order_relaxed)] = i;
+		});
+
+	// 6. the scatter order within a cell depends on thread timing, sort each (short) cell so the pairs come out the same every run
+	threadPool.runJobs(numJobs, [&](const unsigned int job) {
+		unsigned int begin, end;
+		ThreadPool::jobRange(m_numCells, numJobs, job, begin, end);
+		for (unsigned int c = begin; c < end; c++)
+		{
+			if (m_cellStart[c + 1] - m_cellStart[c] > 1)
+				std::sort(m_sortedBoxes.begin() + m_cellStart[c], m_sortedBoxes.begin() + m_cellStart[c + 1]);
+		}
+		});
+}
+
+void CellList::findPairs(const BoxStore& boxes, ThreadPool& threadPool, vector<CollisionPair>& results)
+{
+	const unsigned int numBoxes = boxes.size();
+	const unsigned int numJobs = std::max(threadPool.threadCount(), 1u);
+
+	// pass 1 - count
+	threadPool.runJobs(numJobs, [&](const unsigned int job) {
+		unsigned int begin, end;
+		ThreadPool::jobRange(numBoxes, numJobs, job, begin, end);
+		m_jobTotals[job] = scanPairs<false>(boxes, begin, end, nullptr);
+		});
+
+	unsigned int offset = 0;
+	for (unsigned int& total : m_jobTotals)
+	{
+		const unsigned int t = total;
+		total = offset;
+		offset += t;
+	}
+
+	// only grows the capacity when there are more pairs than any frame before
+	results.resize(offset);
+
+	// pass 2 - write, each job straight in to its own slice of the results
+	threadPool.runJobs(numJobs, [&](const unsigned int job) {
+		unsigned int begin, end;
+		ThreadPool::jobRange(numBoxes, numJobs, job, begin, end);
+		scanPairs<true>(boxes, begin, end, results.data() + m_jobTotals[job]);
+		});
+}
+
+template <bool emit>
+unsigned int CellList::scanPairs(const BoxStore& boxes, const unsigned int begin, const unsigned int end, CollisionPair* output) const
+{
+	unsigned int pairCount = 0;
+
+	for (unsigned int i = begin; i < end; i++)
+	{
+		const XMFLOAT4 a = boxes.positionAndRadius(i);
+		int cx, cy, cz;
+		getCellCoords(m_boxCell[i], cx, cy, cz);
+
+		// for each row of neighbouring cells, the three cells along X are next to each other in the sorted array
+		const int x0 = std::max(cx - 1, 0);
+		const int x1 = std::min(cx + 1, m_dimX - 1);
+		for (int z = std::max(cz - 1, 0); z <= std::min(cz + 1, m_dimZ - 1); z++)
+		{
+			for (int y = std::max(cy - 1, 0); y <= std::min(cy + 1, m_dimY - 1); y++)
+			{
+				const unsigned int first = m_cellStart[getCellIndex(x0, y, z)];
+				const unsigned int last = m_cellStart[getCellIndex(x1, y, z) + 1];
+				for (unsigned int s = first; s < last; s++)
+				{
+					const unsigned int j = m_sortedBoxes[s];
+					if (j <= i)
+						continue;
+
+					const XMFLOAT4 b = boxes.positionAndRadius(j);
+					const float sumRadii = a.w + b.w + m_skin;
+					if (std::abs(a.x - b.x) < sumRadii && std::abs(a.y - b.y) < sumRadii && std::abs(a.z - b.z) < sumRadii)
+					{
+						if constexpr (emit)
+							output[pairCount] = { i, j };
+						pairCount++;
+					}
+				}
+			}
+		}
+	}
+
+	return pairCount;
+}
+
+void CellList::getCellCoords(const unsigned int cell, int& x, int& y, int& z) const
+{
+	x = cell % m_dimX;
+	y = (cell / m_dimX) % m_dimY;
+	z = cell / (m_dimX * m_dimY);
+}
+
+// boxes outside the world bounds are clamped in to the edge cells, which keeps overlapping boxes within a cell of each other
+int CellList::cellCoord(const float value, const float worldMin, const int dim) const
+{
+	const int coord = (int)std::floor((value - worldMin) * m_invCellSize);
+	return std::min(std::max(coord, 0), dim - 1);
+}
@@ -0,0 +1,72 @@
+// MIT License
+// Copyright (c) 2025 David White
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// A compact cell list broadphase, built with a parallel counting sort
+// The fixed world bounds are split in to a dense grid of cells (no hashing). Each frame the boxes are counted
+// per cell, the counts are exclusive prefix summed in to cell start offsets and the box indices are scattered
+// in to one contiguous array - so a cell is just a range [m_cellStart[c], m_cellStart[c + 1]) of that array.
+// Pairs are found in two passes over the same boxes: the first only counts each job's pairs, which gives every
+// job an exact offset in to one output array, and the second writes them there. No push_back, no atomics.
+
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <memory>
+#include "Box.h"
+#include "BoxStore.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+class CellList
+{
+public:
+    CellList() = default;
+
+    // skin pads every box by that much extra on top of its radius - so findPairs returns pairs that are close, not just touching
+    void build(const BoxStore& boxes, ThreadPool& threadPool, const float skin = 0.0f);
+
+    // fills results with every pair of boxes whose AABBs overlap (the same test as ColliderManager::checkCollision,
+    // with the skin added), ordered by index1 and with index1 always less than index2
+    void findPairs(const BoxStore& boxes, ThreadPool& threadPool, vector<CollisionPair>& results);
+
+    unsigned int getCellCount() const { return m_numCells; }
+
+private:
+    int cellCoord(const float value, const float worldMin, const int dim) const;
+    int getCellIndex(const int x, const int y, const int z) const { return (z * m_dimY + y) * m_dimX + x; }
+    void getCellCoords(const unsigned int cell, int& x, int& y, int& z) const;
+
+    // with emit false this only counts the pairs for boxes [begin, end), with emit true it also writes them to output
+    template <bool emit>
+    unsigned int scanPairs(const BoxStore& boxes, const unsigned int begin, const unsigned int end, CollisionPair* output) const;
+
+private:
+    float                   m_skin = 0.0f;
+    float                   m_cellSize = 2.0f * box_scale;
+    float                   m_invCellSize = 1.0f / (2.0f * box_scale);
+    int                     m_dimX = 0;
+    int                     m_dimY = 0;
+    int                     m_dimZ = 0;
+    unsigned int            m_numCells = 0;
+
+    unique_ptr<atomic<unsigned int>[]> m_cellCounts; // counts, then reused as the scatter write cursors
+    unsigned int            m_cellCapacity = 0;
+    vector<unsigned int>    m_cellStart; // m_numCells + 1 entries, the last one is the box count
+    vector<unsigned int>    m_boxCell; // the cell each box is in
+    vector<unsigned int>    m_sortedBoxes; // box indices, grouped by cell (and in index order within a cell)
+
+    vector<float>           m_jobMaxRadius;
+    vector<unsigned int>    m_jobTotals;
+};
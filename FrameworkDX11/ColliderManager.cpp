@@ -2,19 +2,62 @@
 #include "DX11App.h"
 #include "DX11Renderer.h"
 #include "globals.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <string>
+#include "SpaceFillingCurve.h"
 
 
 constexpr int multithreaded_multiplier = 1; // 1 = use the number of native HW threads (probably 16)
 
-ColliderManager::ColliderManager() : m_threadPool(std::thread::hardware_concurrency()* multithreaded_multiplier)
+// The tiled all pairs loops work through the boxes in blocks of this many. A block of 'i' boxes and a tile of
+// 'j' boxes is 2 x 256 x 32 bytes = 16KB, so both stay in a 32KB L1 cache while every i is tested against every j.
+constexpr int all_pairs_tile_size = 256;
+
+// The row kernels write their pairs to a buffer on the stack, for this many boxes at a time, which is then copied to the
+// results - 8KB, and a whole number of the widest registers so the blocks don't leave the kernels any extra tails
+constexpr unsigned int row_kernel_block_size = 1024;
+
+// The movement update is split across the thread pool in jobs of at least this many boxes (256KB) - any fewer and
+// handing out the jobs costs more than moving the boxes
+constexpr unsigned int min_boxes_per_movement_job = 8192;
+
+// [numthreads] in computeshader.hlsl
+constexpr unsigned int compute_shader_group_size = 512;
+
+// The compute shader's pair buffer holds this many pairs per box - plenty for the first hit test, which finds one at
+// most, but a dense pile can find more with the others. Any more than fit are dropped.
+constexpr unsigned int max_gpu_pairs_per_box = 8;
+
+// The test each method was written with, for predicate_per_method
+static int methodPredicate(const int method)
+{
+	switch (method)
+	{
+	case use_cpu_multithread:
+		return predicate_sphere;
+	case use_gpu:
+	case use_gpu_emulated:
+		return predicate_first_hit;
+	default:
+		return predicate_aabb;
+	}
+}
+
+ColliderManager::ColliderManager() : m_threadPool(std::make_unique<ThreadPool>(std::thread::hardware_concurrency()* multithreaded_multiplier, g_task_queue))
 {
 
 }
 
 void ColliderManager::init(ID3D11Device* device, ID3D11DeviceContext* context)
 {
-	m_localCollisionResults.reserve(m_threadPool.threadCount());
-	for (unsigned int i = 0; i < m_threadPool.threadCount(); i++)
+	// pick the widest kernels this CPU can run, once
+	m_simdKernels = &getCollisionKernels(detectSimdLevel());
+	g_simd_kernels_name = m_simdKernels->name;
+
+	m_localCollisionResults.reserve(m_threadPool->threadCount());
+	for (unsigned int i = 0; i < m_threadPool->threadCount(); i++)
 	{
 		vector<CollisionPair> x;
 		m_localCollisionResults.push_back(x);
@@ -32,22 +75,31 @@ void ColliderManager::init(ID3D11Device* device, ID3D11DeviceContext* context)
 		releaseAndCreateCSResources(device);
 
 
-		ID3DBlob* pCSBlob = nullptr;
-		HRESULT hr = DX11Renderer::compileShaderFromFile(L"computeshader.hlsl", "main", "cs_5_0", &pCSBlob);
-		if (FAILED(hr))
+		// one version of the shader per collision test (see PREDICATE in the shader)
+		for (int predicate = 0; predicate < predicate_count; predicate++)
 		{
-			MessageBox(nullptr,
-				L"The Compute Shader cannot be compiled, sorry.", L"Error", MB_OK);
-			return;
+			const string predicateValue = to_string(predicate);
+			const D3D_SHADER_MACRO defines[] = { { "PREDICATE", predicateValue.c_str() }, { nullptr, nullptr } };
 
-		}
+			ID3DBlob* pCSBlob = nullptr;
+			HRESULT hr = DX11Renderer::compileShaderFromFile(L"computeshader.hlsl", "main", "cs_5_0", &pCSBlob, defines);
+			if (FAILED(hr))
+			{
+				MessageBox(nullptr,
+					L"The Compute Shader cannot be compiled, sorry.", L"Error", MB_OK);
+				return;
 
-		// Create the vertex shader
-		hr = device->CreateComputeShader(pCSBlob->GetBufferPointer(), pCSBlob->GetBufferSize(), nullptr, &m_pComputeShader);
-		if (FAILED(hr))
-		{
-			MessageBox(nullptr,
-				L"The Compute Shader cannot be created, sorry.", L"Error", MB_OK);
+			}
+
+			// Create the compute shader
+			hr = device->CreateComputeShader(pCSBlob->GetBufferPointer(), pCSBlob->GetBufferSize(), nullptr, &m_pComputeShader[predicate]);
+			pCSBlob->Release();
+			if (FAILED(hr))
+			{
+				MessageBox(nullptr,
+					L"The Compute Shader cannot be created, sorry.", L"Error", MB_OK);
+				return;
+			}
 		}
 	}
 }
@@ -60,14 +112,45 @@ void ColliderManager::releaseAndCreateCSResources(ID3D11Device* device)
 	m_pStagingBufferCollisionPairs.Reset();
 	m_pStagingBoxBuffer.Reset();
 
+	// room to grow, so adding a few boxes at a time doesn't re-create them every time
+	m_gpuBoxCapacity = std::max(m_boxes.size(), m_gpuBoxCapacity * 2);
+
 	// input boxes
-	createGPUBoxBuffer(device, m_boxes.size(), &m_pBoxBuffer, &m_pBoxBufferSRV);
+	createGPUBoxBuffer(device, m_gpuBoxCapacity, &m_pBoxBuffer);
 	// output collision pairs and counter
-	createCollisionOutputBuffer(device, g_cube_count, &m_pCollisionPairBuffer, &m_pCollisionPairBufferSRV);
+	createCollisionOutputBuffer(device, m_gpuBoxCapacity * max_gpu_pairs_per_box, &m_pCollisionPairBuffer);
 
 	// two CPU readable staging buffers
 	createStagingReadBuffer(device, m_pCollisionPairBuffer, &m_pStagingBufferCollisionPairs);
-	createStagingWriteBuffer(device, g_cube_count, &m_pStagingBoxBuffer);
+	createStagingWriteBuffer(device, m_gpuBoxCapacity, &m_pStagingBoxBuffer);
+
+	createCSViews(device);
+}
+
+void ColliderManager::createCSViews(ID3D11Device* device)
+{
+	m_gpuBoxCount = m_boxes.size();
+	m_maxGPUCollisionPairs = m_gpuBoxCount * max_gpu_pairs_per_box;
+
+	// the boxes, bound to the shader's 't0' register
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format = DXGI_FORMAT_UNKNOWN; // Format must be UNKNOWN for structured buffers
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+	srvDesc.Buffer.FirstElement = 0;
+	srvDesc.Buffer.NumElements = m_gpuBoxCount;
+
+	m_pBoxBufferSRV.Reset();
+	device->CreateShaderResourceView(m_pBoxBuffer.Get(), &srvDesc, m_pBoxBufferSRV.GetAddressOf());
+
+	// the collision pairs, bound to the shader's 'u0' register
+	D3D11_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
+	uavDesc.Format = DXGI_FORMAT_UNKNOWN; // Format must be UNKNOWN for structured buffers
+	uavDesc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+	uavDesc.Buffer.FirstElement = 0;
+	uavDesc.Buffer.NumElements = m_maxGPUCollisionPairs;
+
+	m_pCollisionPairBufferSRV.Reset();
+	device->CreateUnorderedAccessView(m_pCollisionPairBuffer.Get(), &uavDesc, m_pCollisionPairBufferSRV.GetAddressOf());
 }
 
 HRESULT ColliderManager::createStagingReadBuffer(
@@ -106,12 +189,11 @@ HRESULT ColliderManager::createStagingWriteBuffer(
 }
 
 // Creates a read-only structured buffer for the GPU.
-// pSRV_out will be bound to the shader's 't0' register.
+// Its view (createCSViews) will be bound to the shader's 't0' register.
 HRESULT ColliderManager::ColliderManager::createGPUBoxBuffer(
 	ID3D11Device* pDevice,
 	UINT maxBoxes,
-	Microsoft::WRL::ComPtr < ID3D11Buffer>* ppBuffer_out,
-	Microsoft::WRL::ComPtr < ID3D11ShaderResourceView>* ppSRV_out)
+	Microsoft::WRL::ComPtr < ID3D11Buffer>* ppBuffer_out)
 {
 	D3D11_BUFFER_DESC bufferDesc = {};
 	bufferDesc.ByteWidth = sizeof(Box) * maxBoxes;
@@ -120,24 +202,12 @@ HRESULT ColliderManager::ColliderManager::createGPUBoxBuffer(
 	bufferDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
 	bufferDesc.StructureByteStride = sizeof(Box); // Use the corrected 32-byte struct size
 
-	HRESULT hr = pDevice->CreateBuffer(&bufferDesc, nullptr, ppBuffer_out->GetAddressOf());
-	if (FAILED(hr)) return hr;
-
-	// --- 2. Create the Shader Resource View (SRV) ---
-	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-	srvDesc.Format = DXGI_FORMAT_UNKNOWN; // Format must be UNKNOWN for structured buffers
-	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
-	srvDesc.Buffer.FirstElement = 0;
-	srvDesc.Buffer.NumElements = m_boxes.size();
-
-	hr = pDevice->CreateShaderResourceView(ppBuffer_out->Get(), &srvDesc, ppSRV_out->GetAddressOf());
-
-	return hr;
+	return pDevice->CreateBuffer(&bufferDesc, nullptr, ppBuffer_out->GetAddressOf());
 }
 
 void ColliderManager::updateBoxBuffer(
 	ID3D11DeviceContext* pContext,
-	const std::vector<Box>& boxes)
+	const BoxStore& boxes)
 {
 
 	// --- Step 1: Write new data into the staging buffer ---
@@ -145,24 +215,24 @@ void ColliderManager::updateBoxBuffer(
 	HRESULT hr = pContext->Map(m_pStagingBoxBuffer.Get(), 0, D3D11_MAP_WRITE, 0, &mappedResource);
 	if (SUCCEEDED(hr))
 	{
-		memcpy(mappedResource.pData, boxes.data(), sizeof(Box) * boxes.size());
+		boxes.packBoxes(static_cast<Box*>(mappedResource.pData));
 		pContext->Unmap(m_pStagingBoxBuffer.Get(), 0);
 	}
 
 	// --- Step 2: Command the GPU to copy the data ---
-	pContext->CopyResource(m_pBoxBuffer.Get(), m_pStagingBoxBuffer.Get());
+	// only the boxes there are - the buffers have room for more
+	const D3D11_BOX region = { 0, 0, 0, boxes.size() * (UINT)sizeof(Box), 1, 1 };
+	pContext->CopySubresourceRegion(m_pBoxBuffer.Get(), 0, 0, 0, 0, m_pStagingBoxBuffer.Get(), 0, &region);
 
 }
 
 // Creates a writeable buffer for the compute shader to store collision results.
-// pUAV_out will be bound to the shader's 'u0' register.
+// Its view (createCSViews) will be bound to the shader's 'u0' register.
 HRESULT ColliderManager::createCollisionOutputBuffer(
 	ID3D11Device* pDevice,
 	unsigned int maxCollisions,
-	Microsoft::WRL::ComPtr < ID3D11Buffer>* ppBuffer_out,
-	Microsoft::WRL::ComPtr < ID3D11UnorderedAccessView>* ppUAV_out)
+	Microsoft::WRL::ComPtr < ID3D11Buffer>* ppBuffer_out)
 {
-	// --- 1. Create the Buffer Resource ---
 	D3D11_BUFFER_DESC bufferDesc = {};
 	bufferDesc.ByteWidth = sizeof(CollisionPair) * maxCollisions;
 	bufferDesc.Usage = D3D11_USAGE_DEFAULT;
@@ -170,19 +240,7 @@ HRESULT ColliderManager::createCollisionOutputBuffer(
 	bufferDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
 	bufferDesc.StructureByteStride = sizeof(CollisionPair);
 
-	HRESULT hr = pDevice->CreateBuffer(&bufferDesc, nullptr, ppBuffer_out->GetAddressOf());
-	if (FAILED(hr)) return hr;
-
-	// --- 2. Create the Unordered Access View (UAV) ---
-	D3D11_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
-	uavDesc.Format = DXGI_FORMAT_UNKNOWN; // Format must be UNKNOWN for structured buffers
-	uavDesc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
-	uavDesc.Buffer.FirstElement = 0;
-	uavDesc.Buffer.NumElements = maxCollisions;
-
-	hr = pDevice->CreateUnorderedAccessView(ppBuffer_out->Get(), &uavDesc, ppUAV_out->GetAddressOf());
-
-	return hr;
+	return pDevice->CreateBuffer(&bufferDesc, nullptr, ppBuffer_out->GetAddressOf());
 }
 
 // Creates the single-integer buffer for atomic operations.
@@ -228,7 +286,14 @@ void ColliderManager::initBox()
 	float randomXVelocity = -1.0f + static_cast<float>(rand()) / (static_cast<float>(RAND_MAX / 2.0f));
 	box.velocity = { randomXVelocity, 0.0f, 0.0f, 0.0f };
 
-	m_boxes.push_back(box);
+	// Mixed sizes are spread evenly (in log scale) from a tenth to ten times box_scale - two orders of magnitude
+	if (g_mixed_box_sizes)
+	{
+		float t = static_cast<float>(rand()) / static_cast<float>(RAND_MAX);
+		box.positionAndRadius.w = box_scale * std::pow(10.0f, 2.0f * t - 1.0f);
+	}
+
+	insertBox(box);
 }
 
 void ColliderManager::initBoxes()
@@ -238,36 +303,182 @@ void ColliderManager::initBoxes()
 	}
 }
 
+BoxHandle ColliderManager::addBox(const Box& box)
+{
+	const BoxHandle handle = insertBox(box);
+	g_cube_count = m_boxes.size();
+	return handle;
+}
+
+bool ColliderManager::removeBox(const BoxHandle handle)
+{
+	const bool removed = eraseBox(handle);
+	g_cube_count = m_boxes.size();
+	return removed;
+}
+
+// New boxes go on the end, where the broadphases that keep boxes between frames look for them
+BoxHandle ColliderManager::insertBox(const Box& box)
+{
+	m_boxes.push_back(box);
+	if (!m_boxOrigins.empty())
+		m_boxOrigins.push_back(removed_box);
+	return m_boxHandles.insert();
+}
+
+bool ColliderManager::eraseBox(const BoxHandle handle)
+{
+	const unsigned int index = m_boxHandles.erase(handle);
+	if (index == removed_box)
+		return false;
+
+	// taking the last box away moves nothing, but any other moves the last box, and the broadphases that keep box
+	// indices between frames need telling - once per frame, in remapMovedBoxes, however many have moved
+	const unsigned int last = m_boxes.size() - 1;
+	if (index != last && m_boxOrigins.empty())
+	{
+		m_boxOrigins.resize(m_boxes.size());
+		for (unsigned int i = 0; i < m_boxes.size(); i++)
+			m_boxOrigins[i] = i;
+	}
+	if (!m_boxOrigins.empty())
+	{
+		m_boxOrigins[index] = m_boxOrigins[last];
+		m_boxOrigins.pop_back();
+	}
+
+	m_boxes.removeSwap(index);
+	return true;
+}
+
+void ColliderManager::removeAllBoxes()
+{
+	remapMovedBoxes();
+
+	m_boxRemap.assign(m_boxes.size(), removed_box);
+	m_boxes.clear();
+	m_boxHandles.clear();
+	remapBoxes();
+}
+
+void ColliderManager::remapMovedBoxes()
+{
+	if (m_boxOrigins.empty())
+		return;
+
+	// the remap is over the boxes there were when the first one moved - any added since are new to the broadphases
+	unsigned int originalCount = 0;
+	for (const unsigned int origin : m_boxOrigins)
+	{
+		if (origin != removed_box)
+			originalCount = std::max(originalCount, origin + 1);
+	}
+	m_boxRemap.assign(originalCount, removed_box);
+	for (unsigned int i = 0; i < m_boxOrigins.size(); i++)
+	{
+		if (m_boxOrigins[i] != removed_box)
+			m_boxRemap[m_boxOrigins[i]] = i;
+	}
+	m_boxOrigins.clear();
+
+	remapBoxes();
+}
+
+void ColliderManager::remapBoxes()
+{
+	// the broadphases that keep anything between frames - the rest start again every frame anyway
+	m_sweepAndPrune.remapBoxes(m_boxRemap);
+	m_aabbTree.remapBoxes(m_boxRemap);
+	m_neighbourList.invalidate();
+}
+
+// The curve keys are only 30 bits, so the index below them makes every key unique and the sort repeatable
+void ColliderManager::sortBoxesAlongCurve()
+{
+	const unsigned int numBoxes = m_boxes.size();
+	m_curveKeys.resize(numBoxes);
+	for (unsigned int i = 0; i < numBoxes; i++)
+	{
+		const XMFLOAT4 p = m_boxes.positionAndRadius(i);
+		const uint64_t key = g_reorder_curve == curve_hilbert ? hilbertKey(p) : mortonKey(p);
+		m_curveKeys[i] = (key << 32) | i;
+	}
+	std::sort(m_curveKeys.begin(), m_curveKeys.end());
+
+	m_boxOrder.resize(numBoxes);
+	for (unsigned int i = 0; i < numBoxes; i++)
+		m_boxOrder[i] = (unsigned int)m_curveKeys[i];
+	applyBoxOrder();
+}
+
+void ColliderManager::applyBoxOrder()
+{
+	remapMovedBoxes();
+
+	const unsigned int newCount = m_boxOrder.size();
+	m_boxRemap.assign(m_boxes.size(), removed_box);
+	for (unsigned int i = 0; i < newCount; i++)
+		m_boxRemap[m_boxOrder[i]] = i;
+
+	m_boxes.reorder(m_boxOrder.data(), newCount);
+	m_boxHandles.reorder(m_boxOrder.data(), newCount);
+	remapBoxes();
+}
+
 
 void ColliderManager::update(const float deltaTime, ID3D11Device* device, ID3D11DeviceContext* context)
 {
+	m_kernels = g_simd_kernels ? m_simdKernels : &scalarCollisionKernels;
+	m_predicate = g_predicate == predicate_per_method ? methodPredicate(g_ttype) : g_predicate;
+	m_useCompactBoxes = g_compact_boxes;
+	m_uniformRadiusKernels = false;
+	m_pairCount = 0;
+
+	// the pool's injection queue is picked when it is made, so switching it makes a new pool
+	if (g_task_queue != m_threadPool->queueType())
+		m_threadPool = std::make_unique<ThreadPool>(m_threadPool->threadCount(), g_task_queue);
+	m_threadPool->setAdaptiveSpin(g_adaptive_spin);
+
+	// switching between uniform and mixed box sizes starts again with a fresh set of boxes
+	if (g_mixed_box_sizes != m_mixedBoxSizes)
+	{
+		m_mixedBoxSizes = g_mixed_box_sizes;
+		removeAllBoxes();
+	}
 
-	if (g_cube_count != m_boxes.size())
+	if (g_cube_count > m_boxes.size()) // add some more
 	{
-		if (g_cube_count > m_boxes.size()) // add some more
-		{
-			for (unsigned int i = m_boxes.size(); i < g_cube_count; i++)
-				initBox();
-		}
-		else // take some away
-		{
-			m_boxes.resize(g_cube_count);
-			unsigned int box_count = getBoxCount();
-		}
+		for (unsigned int i = m_boxes.size(); i < g_cube_count; i++)
+			initBox();
+	}
+	while (g_cube_count < m_boxes.size()) // take the last ones away, so nothing has to move
+		eraseBox(m_boxHandles.handleAt(m_boxes.size() - 1));
+
+	remapMovedBoxes();
 
-		// Re-create compute shader resources.
-		// Ideally, we would handle variable box counts without full recreation,
-		// but this simplified approach is acceptable for a demo.
+	// the compute shader resources are only re-created when there are more boxes than they have room for - otherwise
+	// it is only the views in to them
+	if (m_boxes.size() > m_gpuBoxCapacity)
 		releaseAndCreateCSResources(device);
-	}
+	else if (m_boxes.size() != m_gpuBoxCount)
+		createCSViews(device);
 
+	// boxes drift apart from their neighbours in memory as they move, so every so often put them back in order
+	if (g_reorder_interval > 0 && ++m_framesSinceReorder >= (unsigned int)g_reorder_interval)
+	{
+		sortBoxesAlongCurve();
+		m_framesSinceReorder = 0;
+	}
 
 	updateMovement(deltaTime);
 
 	switch (g_ttype)
 	{
 		case use_cpu_singlethread:
-			updateCollisionsCPU();
+			if (g_tiled_all_pairs)
+				updateCollisionsCPUTiled();
+			else
+				updateCollisionsCPU();
 		break;
 		case use_cpu_multithread:
 			updateCollisionsCPUMultithreaded();
@@ -275,40 +486,54 @@ void ColliderManager::update(const float deltaTime, ID3D11Device* device, ID3D11
 		case use_gpu:
 			updateCollisionsCS(context);
 			break;
+		case use_gpu_emulated:
+			updateCollisionsCSEmulated();
+			break;
+		case use_cpu_grid:
+			updateCollisionsCPUGrid();
+			break;
+		case use_cpu_sap:
+			updateCollisionsCPUSweepAndPrune();
+			break;
+		case use_cpu_aabb_tree:
+			updateCollisionsCPUAABBTree();
+			break;
+		case use_cpu_lbvh:
+			updateCollisionsCPULBVH();
+			break;
+		case use_cpu_cell_list:
+			updateCollisionsCPUCellList();
+			break;
+		case use_cpu_neighbour_list:
+			updateCollisionsCPUNeighbourList();
+			break;
+		case use_cpu_hierarchical_grid:
+			updateCollisionsCPUHierarchicalGrid();
+			break;
 	}
+
+	g_collision_stats.predicate = predicateName(m_predicate);
+	g_collision_stats.pairCount = m_pairCount;
+	g_collision_stats.uniformRadius = m_uniformRadiusKernels;
 }
 
+// Every box moves on its own, so the boxes can be split between the threads in any way and still come out the same
 void ColliderManager::updateMovement(const float deltaTime)
 {
-	const float floorY = 0.0f;
-
-	for (unsigned int i = 0; i < m_boxes.size(); i++) {
-
-		Box& box = m_boxes[i];
-
-		// Update velocity due to gravity
-		box.velocity.y += gravity * deltaTime;
-
-		// Update position based on velocity
-		box.positionAndRadius.x += box.velocity.x * deltaTime;
-		box.positionAndRadius.y += box.velocity.y * deltaTime;
-		box.positionAndRadius.z += box.velocity.z * deltaTime;
-
-		// Check for collision with the floor
-		if (box.positionAndRadius.y - box.positionAndRadius.w < floorY) {
-			box.positionAndRadius.y = floorY + box.positionAndRadius.w;
-			float dampening = 0.7f;
-			box.velocity.y = -box.velocity.y * dampening;
-		}
-
-		// Check for collision with the walls
-		if (box.positionAndRadius.x - box.positionAndRadius.w < minX || box.positionAndRadius.x + box.positionAndRadius.w > maxX) {
-			box.velocity.x = -box.velocity.x;
-		}
-		if (box.positionAndRadius.z - box.positionAndRadius.w < minZ || box.positionAndRadius.z + box.positionAndRadius.w > maxZ) {
-			box.velocity.z = -box.velocity.z;
-		}
+	const unsigned int numBoxes = m_boxes.size();
+	const BoxArrays boxes = m_boxes.arrays();
+	if (!g_parallel_movement)
+	{
+		m_kernels->integrate(boxes, 0, numBoxes, deltaTime);
+		return;
 	}
+
+	// a share per thread, but never so few boxes that starting the job costs more than moving them
+	const unsigned int threads = std::max(m_threadPool->threadCount(), 1u);
+	const unsigned int grain = std::max(min_boxes_per_movement_job, (numBoxes + threads - 1) / threads);
+	m_threadPool->parallelFor(numBoxes, grain, [this, &boxes, deltaTime](const unsigned int begin, const unsigned int end) {
+		m_kernels->integrate(boxes, begin, end, deltaTime);
+		});
 }
 
 
@@ -318,7 +543,7 @@ void ColliderManager::updateCollisionsCS(ID3D11DeviceContext* context)
 	updateBoxBuffer(context, m_boxes);
 
 	// 1. Set the Compute Shader
-	context->CSSetShader(m_pComputeShader.Get(), nullptr, 0);
+	context->CSSetShader(m_pComputeShader[m_predicate].Get(), nullptr, 0);
 
 	// 2. Bind the Buffers to the Shader
 	//    SRV for reading sphere data, UAV for writing collision pairs and the atomic counter.
@@ -336,8 +561,8 @@ void ColliderManager::updateCollisionsCS(ID3D11DeviceContext* context)
 	// 3. Dispatch the Shader
 	//    For 1000 boxes, we launch 1000 threads.
 	//    The group size (e.g., 64) is defined in the HLSL shader.
-	unsigned int num_boxes = g_cube_count;
-	unsigned int threadsPerGroup = 512;
+	unsigned int num_boxes = m_boxes.size();
+	unsigned int threadsPerGroup = compute_shader_group_size;
 	unsigned int thread_groups = (num_boxes + threadsPerGroup - 1) / threadsPerGroup; // Calculate number of groups needed
 	context->Dispatch(thread_groups, 1, 1);
 
@@ -352,7 +577,8 @@ void ColliderManager::updateCollisionsCS(ID3D11DeviceContext* context)
 	//    Copy the collision pair buffer and the atomic counter buffer to staging
 	//    buffers so the CPU can read the data.
 
-	context->CopyResource(m_pStagingBufferCollisionPairs.Get(), m_pCollisionPairBuffer.Get());
+	const D3D11_BOX pairRegion = { 0, 0, 0, m_maxGPUCollisionPairs * (UINT)sizeof(CollisionPair), 1, 1 };
+	context->CopySubresourceRegion(m_pStagingBufferCollisionPairs.Get(), 0, 0, 0, 0, m_pCollisionPairBuffer.Get(), 0, &pairRegion);
 	context->CopyResource(m_pStagingBufferCounter.Get(), m_pCounterBuffer.Get());
 
 	D3D11_MAPPED_SUBRESOURCE mapped_resource;
@@ -364,11 +590,8 @@ void ColliderManager::updateCollisionsCS(ID3D11DeviceContext* context)
 	context->Map(m_pStagingBufferCollisionPairs.Get(), 0, D3D11_MAP_READ, 0, &mapped_resource);
 	CollisionPair* collision_pairs = static_cast<CollisionPair*>(mapped_resource.pData);
 
-	for (unsigned int i = 0; i < collision_count; i++) {
-		CollisionPair cp = collision_pairs[i];
-		// Process the collision between pairs[i].index1 and pairs[i].index2
-		resolveCollision(m_boxes[cp.index1], m_boxes[cp.index2]);
-	}
+	// the counter keeps counting past the end of the buffer
+	resolveCollisions(collision_pairs, std::min(collision_count, m_maxGPUCollisionPairs));
 
 	// release the resources
 	context->Unmap(m_pStagingBufferCollisionPairs.Get(), 0);
@@ -376,151 +599,387 @@ void ColliderManager::updateCollisionsCS(ID3D11DeviceContext* context)
 }
 
 
+// The compute shader run on the CPU, to check the GPU results against and to compare the GPU with the same algorithm on
+// the CPU. Each job runs a range of thread groups, each emulated thread i running the shader's loop over j. The pairs
+// come out in no particular order through an atomic counter, as they do on the GPU.
+template <class Predicate>
+void ColliderManager::emulateComputeShader()
+{
+	const unsigned int numBoxes = (unsigned int)m_boxes.size();
+	const unsigned int threadGroups = (numBoxes + compute_shader_group_size - 1) / compute_shader_group_size;
+	const unsigned int jobCount = std::min(threadGroups, m_threadPool->threadCount());
+
+	m_emulatedCollisionPairs.resize(m_maxGPUCollisionPairs);
+	std::atomic<unsigned int> collisionCount(0);
+
+	m_threadPool->runJobs(jobCount, [this, numBoxes, threadGroups, jobCount, &collisionCount](const unsigned int job) {
+		unsigned int firstGroup, lastGroup;
+		ThreadPool::jobRange(threadGroups, jobCount, job, firstGroup, lastGroup);
+
+		const unsigned int iEnd = std::min(lastGroup * compute_shader_group_size, numBoxes);
+		for (unsigned int i = firstGroup * compute_shader_group_size; i < iEnd; i++)
+		{
+			for (unsigned int j = i + 1; j < numBoxes; j++)
+			{
+				if (overlaps<Predicate>(m_boxes, i, j))
+				{
+					const unsigned int writeIndex = collisionCount++;
+					if (writeIndex < m_maxGPUCollisionPairs)
+						m_emulatedCollisionPairs[writeIndex] = { i, j };
+
+					if (Predicate::firstHitOnly)
+						break;
+				}
+			}
+		}
+		});
+
+	resolveCollisions(m_emulatedCollisionPairs.data(), std::min(collisionCount.load(), m_maxGPUCollisionPairs));
+}
+
+void ColliderManager::updateCollisionsCSEmulated()
+{
+	if (m_boxes.empty()) {
+		return;
+	}
+
+	switch (m_predicate)
+	{
+	case predicate_aabb:
+		emulateComputeShader<AABBPredicate>();
+		break;
+	case predicate_sphere:
+		emulateComputeShader<SpherePredicate>();
+		break;
+	case predicate_first_hit:
+		emulateComputeShader<FirstHitPredicate>();
+		break;
+	}
+}
+
+
+// Resolving only changes velocities, so finding every pair first and then resolving them in i, j order is the same
+// as resolving each pair as it is found - and lets the row kernel test several boxes at once
 void ColliderManager::updateCollisionsCPU()
 {
+	m_collisionResults.clear();
+	updateBoxSoA();
+
+	// Check for collisions with other boxes (only later in the list, avoids double checks)
+	findCollisionsWorker(0, m_boxes.size(), &m_collisionResults);
+
+	resolveCollisions(m_collisionResults);
+}
+
+
+// The same pairs and checks as updateCollisionsCPU, but walking the upper triangle in L1 sized tiles.
+// Without tiling, each i streams every later box through the cache again, so this measures the checks rather than memory.
+// The tiles visit the pairs in a different order, so they're collected first and resolved afterwards, in tile order.
+void ColliderManager::updateCollisionsCPUTiled()
+{
+	m_collisionResults.clear();
+	updateBoxSoA();
+
+	findCollisionsWorkerTiled(0, m_boxes.size(), &m_collisionResults);
+
+	resolveCollisions(m_collisionResults);
+}
+
+
+// Same checks and resolution order as updateCollisionsCPU, but only against boxes in neighbouring grid cells
+void ColliderManager::updateCollisionsCPUGrid()
+{
+	m_spatialGrid.build(m_boxes);
+	m_collisionResults.clear();
+
 	for (unsigned int i = 0; i < m_boxes.size(); i++) {
 
-		Box& box = m_boxes[i];
-		// Check for collisions with other boxes
-		for (unsigned int j = i + 1; j < m_boxes.size(); j++) // only check with boxes later in the list, avoids double checks
+		// the candidates come out in bucket order, sort them so the pairs resolve in the same order as the all pairs loop
+		m_spatialGrid.query(i, m_gridCandidates);
+		std::sort(m_gridCandidates.begin(), m_gridCandidates.end());
+
+		for (unsigned int j : m_gridCandidates)
 		{
-			Box& other = m_boxes[j];
-			if (checkCollision(box, other)) {
-				resolveCollision(box, other);
+			if (checkCollision(i, j)) {
+				m_collisionResults.push_back({ i, j });
 			}
 		}
 	}
+
+	applyPredicate(m_collisionResults);
+	resolveCollisions(m_collisionResults);
 }
 
 
-// This is the main entry point to run the CPU collision check
-void ColliderManager::updateCollisionsCPUMultithreaded()
+// The endpoint list is kept sorted between frames, so this relies on updateMovement having only nudged the boxes
+void ColliderManager::updateCollisionsCPUSweepAndPrune()
 {
-	if (m_boxes.empty()) {
-		return;
-	}
+	m_sweepAndPrune.update(m_boxes);
+
+	m_collisionResults.clear();
+	m_sweepAndPrune.findPairs(m_boxes, m_collisionResults);
+
+	applyPredicate(m_collisionResults);
+	resolveCollisions(m_collisionResults);
+}
+
+
+// Leaves only move in the tree when a box leaves its fat bounds, so most frames this is just the queries
+void ColliderManager::updateCollisionsCPUAABBTree()
+{
+	m_aabbTree.update(m_boxes);
+
+	m_collisionResults.clear();
+	m_aabbTree.findPairs(m_boxes, m_collisionResults);
+
+	applyPredicate(m_collisionResults);
+	resolveCollisions(m_collisionResults);
+}
 
+
+// Built from scratch each frame, with every stage spread across the thread pool
+void ColliderManager::updateCollisionsCPULBVH()
+{
 	for (unsigned int i = 0; i < m_localCollisionResults.size(); i++) {
 		m_localCollisionResults[i].clear();
 	}
 
-	const int numBoxes = m_boxes.size();
-	const int numThreads = m_threadPool.threadCount();
-	int workPerThread = numBoxes / numThreads;
+	m_lbvh.build(m_boxes, *m_threadPool);
+	m_lbvh.findPairs(m_boxes, *m_threadPool, m_localCollisionResults);
 
-	// Set the counter to the number of jobs we're about to create
-	m_jobsRemaining = numThreads;
+	resolveLocalCollisionResults();
+}
 
-	int startIndex = 0;
-	for (int i = 0; i < numThreads; ++i)
-	{
-		int endIndex = (i == numThreads - 1) ? numBoxes : startIndex + workPerThread;
-		vector<CollisionPair>* resultsForThisThread = &m_localCollisionResults[i];
 
-		// Create a lambda function for the job
-		auto job = [this, startIndex, endIndex, resultsForThisThread]() {
-			findCollisionsWorker(startIndex, endIndex, resultsForThisThread);
-			// This thread's job is done, so decrement the counter
-			m_jobsRemaining--;
+// The pairs are written straight in to m_collisionResults, which only ever grows to the largest pair count seen
+void ColliderManager::updateCollisionsCPUCellList()
+{
+	m_cellList.build(m_boxes, *m_threadPool);
+	m_cellList.findPairs(m_boxes, *m_threadPool, m_collisionResults);
 
-			};
+	applyPredicate(m_collisionResults);
+	resolveCollisions(m_collisionResults);
+}
 
-		// Add the job to the thread pool's queue
-		m_threadPool.enqueue(job);
 
-		startIndex = endIndex;
+// Most frames this only re-checks the candidate pairs cached by the last rebuild
+void ColliderManager::updateCollisionsCPUNeighbourList()
+{
+	for (unsigned int i = 0; i < m_localCollisionResults.size(); i++) {
+		m_localCollisionResults[i].clear();
 	}
 
-	// Wait for all jobs to finish
-	// This is a "spin-wait", which is fine here since the work is short
-	while (m_jobsRemaining > 0) {
-		// hint to the OS scheduler that this thread is cool with being lower priority
-		std::this_thread::yield();
+	m_neighbourList.update(m_boxes, *m_threadPool);
+	m_neighbourList.findPairs(m_boxes, *m_threadPool, m_localCollisionResults);
+
+	resolveLocalCollisionResults();
+}
+
+
+// Each box is bucketed in the grid level that matches its size, so mixed sizes don't crowd the small boxes together
+void ColliderManager::updateCollisionsCPUHierarchicalGrid()
+{
+	m_hierarchicalGrid.build(m_boxes);
+
+	m_collisionResults.clear();
+	m_hierarchicalGrid.findPairs(m_boxes, m_collisionResults);
+
+	applyPredicate(m_collisionResults);
+	resolveCollisions(m_collisionResults);
+}
+
+
+// This is the main entry point to run the CPU collision check
+// The rows are split in to chunks with equal numbers of pairs (row i only tests the boxes after it, so equal numbers of
+// rows would leave the first thread with nearly twice the average and the last with almost none). parallelFor gives
+// each thread the next chunk as it finishes the last, which also evens out threads that get less of the CPU. Every chunk
+// has its own results and they are resolved in chunk order, so the pairs resolve in the same order however the chunks
+// were taken.
+void ColliderManager::updateCollisionsCPUMultithreaded()
+{
+	if (m_boxes.empty()) {
+		return;
 	}
 
-	for (vector<CollisionPair> vecCP : m_localCollisionResults) {
-		for(const CollisionPair& cp : vecCP){
-			// Process the collision between pairs[i].index1 and pairs[i].index2
-			resolveCollision(m_boxes[cp.index1], m_boxes[cp.index2]);
+	const unsigned int numBoxes = m_boxes.size();
+	const unsigned int numThreads = m_threadPool->threadCount();
+	const unsigned int chunkCount = std::min(numThreads * (unsigned int)std::max(g_all_pairs_chunks_per_thread, 1), numBoxes);
+	if (m_chunkCollisionResults.size() < chunkCount)
+		m_chunkCollisionResults.resize(chunkCount);
+
+	const bool tiled = g_tiled_all_pairs;
+
+	updateBoxSoA();
+
+	m_threadPool->parallelFor(chunkCount, 1, [this, numBoxes, chunkCount, tiled](const unsigned int firstChunk, const unsigned int lastChunk) {
+		for (unsigned int chunk = firstChunk; chunk < lastChunk; chunk++)
+		{
+			unsigned int startIndex, endIndex;
+			ThreadPool::triangleJobRange(numBoxes, chunkCount, chunk, startIndex, endIndex);
+
+			vector<CollisionPair>* resultsForThisChunk = &m_chunkCollisionResults[chunk];
+			resultsForThisChunk->clear();
+			if (tiled)
+				findCollisionsWorkerTiled(startIndex, endIndex, resultsForThisChunk);
+			else
+				findCollisionsWorker(startIndex, endIndex, resultsForThisChunk);
 		}
+		});
+
+	for (unsigned int chunk = 0; chunk < chunkCount; chunk++) {
+		resolveCollisions(m_chunkCollisionResults[chunk]);
 	}
 }
 
 // The worker function is now a private member method
 void ColliderManager::findCollisionsWorker(int startIndex, int endIndex, vector<CollisionPair>* results)
 {
-	int localCollisionCounter = 0;
-	using namespace DirectX;
+	const unsigned int numBoxes = m_boxes.size();
 
 	for (int i = startIndex; i < endIndex; ++i)
 	{
-		XMVECTOR box1Data = XMLoadFloat4(&m_boxes[i].positionAndRadius);
-
-		for (int j = i + 1; j < m_boxes.size(); ++j)
-		{
-			localCollisionCounter++;
-			XMVECTOR box2Data = XMLoadFloat4(&m_boxes[j].positionAndRadius);
+		findRowOverlaps(i, i + 1, numBoxes, *results);
+	}
+}
 
-			XMVECTOR distVec = XMVectorSubtract(box1Data, box2Data);
-			XMVECTOR distSqVec = XMVector3LengthSq(distVec);
+// As findCollisionsWorker, for the rows [startIndex, endIndex), but a block of rows at a time against L1 sized tiles of columns
+void ColliderManager::findCollisionsWorkerTiled(int startIndex, int endIndex, vector<CollisionPair>* results)
+{
+	const bool firstHitOnly = m_predicate == predicate_first_hit;
+	bool rowDone[all_pairs_tile_size];
 
-			float radius1 = XMVectorGetW(box1Data);
-			float radius2 = XMVectorGetW(box2Data);
-			float sumRadii = radius1 + radius2;
+	const int numBoxes = m_boxes.size();
+	for (int blockStart = startIndex; blockStart < endIndex; blockStart += all_pairs_tile_size)
+	{
+		const int blockEnd = std::min(blockStart + all_pairs_tile_size, endIndex);
+		std::fill(rowDone, rowDone + all_pairs_tile_size, false);
 
-			float distSq;
-			XMStoreFloat(&distSq, distSqVec);
+		for (int tileStart = blockStart; tileStart < numBoxes; tileStart += all_pairs_tile_size)
+		{
+			const int tileEnd = std::min(tileStart + all_pairs_tile_size, numBoxes);
 
-			if (distSq < sumRadii * sumRadii)
+			for (int i = blockStart; i < blockEnd; ++i)
 			{
-				results->push_back({ (unsigned int)i, (unsigned int)j });
+				const int jStart = std::max(tileStart, i + 1);
+				if (jStart >= tileEnd || rowDone[i - blockStart])
+					continue;
+
+				// a first hit row is finished once it has found a hit, so it skips the later tiles
+				const size_t pairCount = results->size();
+				findRowOverlaps(i, jStart, tileEnd, *results);
+				if (firstHitOnly && results->size() != pairCount)
+					rowDone[i - blockStart] = true;
 			}
 		}
 	}
 }
 
-void ColliderManager::resolveCollision(Box& a, Box& b) {
-	XMFLOAT3 normal = { a.positionAndRadius.x - b.positionAndRadius.x, a.positionAndRadius.y - b.positionAndRadius.y, a.positionAndRadius.z - b.positionAndRadius.z };
+// The kernels never touch the vector themselves - they are compiled for other instruction sets (see CollisionKernels.h)
+void ColliderManager::findRowOverlaps(const unsigned int i, const unsigned int jBegin, const unsigned int jEnd, vector<CollisionPair>& results)
+{
+	CollisionPair pairs[row_kernel_block_size];
+	for (unsigned int j = jBegin; j < jEnd; j += row_kernel_block_size)
+	{
+		const unsigned int blockEnd = std::min(j + row_kernel_block_size, jEnd);
+		const unsigned int found = m_useCompactBoxes ?
+			m_kernels->findCompactOverlaps[m_predicate](m_compactBoxes.view(), i, j, blockEnd, pairs) :
+			m_kernels->findOverlaps[m_predicate](m_boxSoA, i, j, blockEnd, pairs);
+		results.insert(results.end(), pairs, pairs + found);
+
+		// a first hit row is done once it has found one
+		if (found > 0 && m_predicate == predicate_first_hit)
+			return;
+	}
+}
 
-	float length = std::sqrt(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
-	// Normalize the normal vector
-	if (length > 0)
+void ColliderManager::updateBoxSoA()
+{
+	if (m_useCompactBoxes)
 	{
-		normal.x /= length;
-		normal.y /= length;
-		normal.z /= length;
+		m_compactBoxes.pack(m_boxes);
+		m_uniformRadiusKernels = m_compactBoxes.hasSharedRadius();
+		return;
 	}
 
-	float relativeVelocityX = a.velocity.x - b.velocity.x;
-	float relativeVelocityY = a.velocity.y - b.velocity.y;
-	float relativeVelocityZ = a.velocity.z - b.velocity.z;
+	// the row kernels read the store's own arrays - only the radii need checking, every frame rather than trusting
+	// g_mixed_box_sizes, so the kernels can never use the wrong radius
+	const unsigned int numBoxes = m_boxes.size();
+	const float* radius = m_boxes.radius();
+	const float firstRadius = numBoxes > 0 ? radius[0] : 0.0f;
+	bool uniformRadius = true;
+	for (unsigned int i = 0; i < numBoxes && uniformRadius; i++)
+		uniformRadius = radius[i] == firstRadius;
+
+	m_boxSoA = { m_boxes.x(), m_boxes.y(), m_boxes.z(), uniformRadius ? nullptr : radius, firstRadius, numBoxes };
+	m_uniformRadiusKernels = uniformRadius;
+}
 
-	// Compute the relative velocity along the normal
-	float impulse = relativeVelocityX * normal.x + relativeVelocityY * normal.y + relativeVelocityZ * normal.z;
+void ColliderManager::resolveCollisions(const CollisionPair* pairs, const unsigned int count) {
+	if (g_batched_resolve && m_kernels->resolveCollisionsBatched)
+	{
+		schedulePairs(pairs, count, m_boxes.size(), m_pairSchedule);
+		m_kernels->resolveCollisionsBatched(m_boxes.arrays(), m_pairSchedule.pairs.data(), m_pairSchedule.levelStarts.data(), (unsigned int)m_pairSchedule.levelStarts.size() - 1, g_exact_resolve);
+	}
+	else
+		m_kernels->resolveCollisions(m_boxes.arrays(), pairs, count);
+	m_pairCount += count;
+}
 
-	// Ignore collision if objects are moving away from each other
-	if (impulse > 0) {
+void ColliderManager::resolveCollisions(const vector<CollisionPair>& pairs) {
+	resolveCollisions(pairs.data(), (unsigned int)pairs.size());
+}
+
+// The per thread results of the multi threaded broadphases
+void ColliderManager::resolveLocalCollisionResults()
+{
+	if (m_predicate == predicate_aabb)
+	{
+		for (const vector<CollisionPair>& vecCP : m_localCollisionResults) {
+			resolveCollisions(vecCP);
+		}
 		return;
 	}
 
-	// Compute the collision impulse scalar
-	float e = 0.01f; // Coefficient of restitution (0 = inelastic, 1 = elastic)
-	float dampening = 0.9f; // Dampening factor (0.9 = 10% energy reduction)
-	float j = -(1.0f + e) * impulse * dampening;
+	// the other tests need all the pairs together
+	m_collisionResults.clear();
+	for (const vector<CollisionPair>& vecCP : m_localCollisionResults) {
+		m_collisionResults.insert(m_collisionResults.end(), vecCP.begin(), vecCP.end());
+	}
 
-	// Apply the impulse to the boxes' velocities
-	a.velocity.x += j * normal.x;
-	a.velocity.y += j * normal.y;
-	a.velocity.z += j * normal.z;
-	b.velocity.x -= j * normal.x;
-	b.velocity.y -= j * normal.y;
-	b.velocity.z -= j * normal.z;
+	applyPredicate(m_collisionResults);
+	resolveCollisions(m_collisionResults);
 }
 
+// The broadphases find the AABB overlaps. A sphere overlap is always an AABB overlap, so the other tests are just a
+// filter of those pairs - for the first hit test, the first sphere hit of each box in index order.
+void ColliderManager::applyPredicate(vector<CollisionPair>& pairs)
+{
+	if (m_predicate == predicate_aabb)
+		return;
+
+	if (m_predicate == predicate_first_hit)
+	{
+		std::sort(pairs.begin(), pairs.end(), [](const CollisionPair& a, const CollisionPair& b) {
+			return a.index1 != b.index1 ? a.index1 < b.index1 : a.index2 < b.index2;
+			});
+	}
+
+	unsigned int lastIndex1 = UINT_MAX;
+	unsigned int kept = 0;
+	for (const CollisionPair& cp : pairs)
+	{
+		if (m_predicate == predicate_first_hit && cp.index1 == lastIndex1)
+			continue;
 
-bool ColliderManager::checkCollision(const Box& a, const Box& b) {
+		if (overlaps<SpherePredicate>(m_boxes, cp.index1, cp.index2))
+		{
+			pairs[kept++] = cp;
+			lastIndex1 = cp.index1;
+		}
+	}
+	pairs.resize(kept);
+}
 
-	return (std::abs(a.positionAndRadius.x - b.positionAndRadius.x) < (a.positionAndRadius.w + b.positionAndRadius.w)) &&
-		(std::abs(a.positionAndRadius.y - b.positionAndRadius.y) < (a.positionAndRadius.w + b.positionAndRadius.w)) &&
-		(std::abs(a.positionAndRadius.z - b.positionAndRadius.z) < (a.positionAndRadius.w + b.positionAndRadius.w));
+bool ColliderManager::checkCollision(const unsigned int i, const unsigned int j) {
+	return overlaps<AABBPredicate>(m_boxes, i, j);
 }
@@ -17,6 +17,23 @@
 // CPU single threaded
 // CPU multi threaded
 // GPU using Compute Shaders
+// (and the compute shader emulated on the CPU)
+// Each was written with a different collision test - AABB, sphere, and sphere but only the first hit per box - so any
+// method can be switched to any of the tests (see CollisionPredicates.h) to compare them fairly.
+// The two CPU methods can also walk the pairs in cache sized tiles - still every pair, just in a friendlier order,
+// and test a compact 16 bit quantized copy of the boxes rather than the floats (see CompactBoxes.h).
+// For comparison, some optimised CPU broadphases are also available. They find the same pairs as the
+// single threaded method, but avoid testing every pair:
+// CPU spatial hash grid
+// CPU incremental sweep and prune
+// CPU dynamic AABB tree
+// CPU multi threaded linear BVH (rebuilt every frame)
+// CPU multi threaded cell list (counting sorted every frame)
+// CPU multi threaded Verlet neighbour lists (only rebuilt when boxes have moved far enough)
+// CPU hierarchical grid (for boxes of mixed sizes)
+// Every so often the boxes are sorted along a space-filling curve, so boxes close in space are close in memory.
+// Boxes can be added and removed one at a time without starting again - a BoxHandle follows its box wherever it has
+// been moved to (see BoxSlotMap.h), and the GPU buffers only grow when the boxes outgrow them.
 
 
 #pragma once
@@ -25,39 +42,31 @@
 #include <DirectXMath.h>
 #include <d3dcompiler.h>
 #include <vector>
+#include <cstdint>
 #include <thread>
 #include <mutex>
 #include "ThreadPool.h" // Include your new thread pool
 #include <atomic>
 #include <wrl.h>
+#include "Box.h"
+#include "BoxStore.h"
+#include "BoxSlotMap.h"
+#include "SpatialGrid.h"
+#include "SweepAndPrune.h"
+#include "DynamicAABBTree.h"
+#include "LBVH.h"
+#include "CellList.h"
+#include "NeighbourList.h"
+#include "HierarchicalGrid.h"
+#include "AlignedAllocator.h"
+#include "CollisionKernels.h"
+#include "CompactBoxes.h"
 
 class DX11App;
 
 using namespace DirectX;
 using namespace std;
 
-constexpr float minX = -10.0f;
-constexpr float maxX = 30.0f;
-constexpr float minZ = -30.0f;
-constexpr float maxZ = 30.0f;
-constexpr float box_offset = 10.0f;
-
-constexpr float box_scale = 0.25;
-
-constexpr float gravity = -9.8f;
-
-struct  Box {
-    XMFLOAT4 positionAndRadius; // this might seem odd, but this method is explicit in the packing for hlsl
-    XMFLOAT4 velocity; // this only needs to be 3, but to avoid HLSL packing errors 4 is again explicit
-};
-
-struct CollisionPair {
-    unsigned int index1;
-    unsigned int index2;
-};
-
-
-
 class ColliderManager
 {
 public:
@@ -73,14 +82,32 @@ public:
 
     void init(ID3D11Device* device, ID3D11DeviceContext* context);
     void update(const float deltaTime, ID3D11Device* device, ID3D11DeviceContext* context);
-    Box* getBox(const unsigned int boxIndex) 
+    // The "Number of Cubes" slider adds and removes boxes the same way, and follows the count these leave
+    BoxHandle addBox(const Box& box);
+    // false if the box has already gone
+    bool removeBox(const BoxHandle handle);
+
+    // an invalid view if the box has gone
+    BoxView getBox(const BoxHandle handle)
+    {
+        const unsigned int boxIndex = m_boxHandles.indexOf(handle);
+        if (boxIndex == removed_box)
+            return BoxView();
+        return m_boxes.view(boxIndex);
+    }
+
+    // by index, for going through all the boxes - removing or sorting the boxes moves them, so use a handle to
+    // follow one box
+    BoxView getBox(const unsigned int boxIndex) 
     { 
         if (boxIndex < m_boxes.size() && boxIndex >= 0)
-            return &m_boxes[boxIndex];
+            return m_boxes.view(boxIndex);
         else
-            return nullptr;
+            return BoxView();
     } 
 
+    BoxHandle getBoxHandle(const unsigned int boxIndex) { return m_boxHandles.handleAt(boxIndex); }
+
     unsigned int getBoxCount() { return m_boxes.size(); }
 
 private: // methods
@@ -88,13 +115,40 @@ private: // methods
     void updateMovement(const float deltaTime);
     
     void updateCollisionsCPU();
+    void updateCollisionsCPUTiled();
     void updateCollisionsCPUMultithreaded();
+    void updateCollisionsCPUGrid();
+    void updateCollisionsCPUSweepAndPrune();
+    void updateCollisionsCPUAABBTree();
+    void updateCollisionsCPULBVH();
+    void updateCollisionsCPUCellList();
+    void updateCollisionsCPUNeighbourList();
+    void updateCollisionsCPUHierarchicalGrid();
     void updateCollisionsCS(ID3D11DeviceContext* context);
+    void updateCollisionsCSEmulated();
+    template <class Predicate>
+    void emulateComputeShader();
 
     void initBox();
     void initBoxes();
-    void resolveCollision(Box& a, Box& b);
-    bool checkCollision(const Box& a, const Box& b);
+    // addBox and removeBox, without changing g_cube_count
+    BoxHandle insertBox(const Box& box);
+    bool eraseBox(const BoxHandle handle);
+    void removeAllBoxes();
+    // sort the boxes along g_reorder_curve
+    void sortBoxesAlongCurve();
+    // move the box at m_boxOrder[i] to i, dropping any not in m_boxOrder, and remap everything that holds box indices
+    void applyBoxOrder();
+    // tell everything that holds box indices where the boxes removeBox has moved this frame went
+    void remapMovedBoxes();
+    // give everything that holds box indices m_boxRemap
+    void remapBoxes();
+    void resolveCollisions(const CollisionPair* pairs, const unsigned int count); // in order
+    void resolveCollisions(const vector<CollisionPair>& pairs);
+    void resolveLocalCollisionResults();
+    // keep only the pairs that pass m_predicate, from pairs that pass the AABB test
+    void applyPredicate(vector<CollisionPair>& pairs);
+    bool checkCollision(const unsigned int i, const unsigned int j);
 
 
     HRESULT createStagingReadBuffer(
@@ -111,20 +165,18 @@ private: // methods
     HRESULT createGPUBoxBuffer(
         ID3D11Device* pDevice,
         UINT maxBoxes,
-        Microsoft::WRL::ComPtr < ID3D11Buffer>* ppBuffer_out,
-        Microsoft::WRL::ComPtr < ID3D11ShaderResourceView>* ppSRV_out);
+        Microsoft::WRL::ComPtr < ID3D11Buffer>* ppBuffer_out);
 
     // update the input buffer
     void updateBoxBuffer(
         ID3D11DeviceContext* pContext,
-        const std::vector<Box>& boxes);
+        const BoxStore& boxes);
 
     // create the output buffer the compute shader will write to
     HRESULT createCollisionOutputBuffer(
         ID3D11Device* pDevice,
         unsigned int maxCollisions,
-        Microsoft::WRL::ComPtr < ID3D11Buffer>* ppBuffer_out,
-        Microsoft::WRL::ComPtr < ID3D11UnorderedAccessView>* ppUAV_out);
+        Microsoft::WRL::ComPtr < ID3D11Buffer>* ppBuffer_out);
 
     // create a counter buffer the compute shader will write to
     HRESULT createAtomicCounterBuffer(
@@ -134,19 +186,63 @@ private: // methods
 
     // Worker function for each thread
     void findCollisionsWorker(int startIndex, int endIndex, vector<CollisionPair>* results);
+    void findCollisionsWorkerTiled(int startIndex, int endIndex, vector<CollisionPair>* results);
+
+    // the row kernel for this frame's test, on m_boxSoA or m_compactBoxes
+    void findRowOverlaps(const unsigned int i, const unsigned int jBegin, const unsigned int jEnd, vector<CollisionPair>& results);
 
+    // point m_boxSoA at the box positions and radii (or pack m_compactBoxes) for the row kernels
+    void updateBoxSoA();
+
+    // the GPU buffers are made for m_gpuBoxCapacity boxes, and only re-created when there are more boxes than that
     void releaseAndCreateCSResources(ID3D11Device* device);
+    // the views the compute shader sees the buffers through, which are re-created for each box count - the shader
+    // takes the number of boxes and the pair limit from their sizes
+    void createCSViews(ID3D11Device* device);
 
 private: // variables
 
-    ThreadPool          m_threadPool;
-    std::atomic<int>    m_jobsRemaining; // For synchronizing
-    vector<Box>         m_boxes;
+    std::unique_ptr<ThreadPool> m_threadPool; // made again when g_task_queue changes
+    BoxStore            m_boxes;
+    bool                m_mixedBoxSizes = false; // the setting the current boxes were created with
+
+    BoxSlotMap              m_boxHandles;
+    vector<unsigned int>    m_boxOrder; // for applyBoxOrder
+    vector<unsigned int>    m_boxRemap; // where each box has gone to, for remapBoxes
+    vector<unsigned int>    m_boxOrigins; // once removeBox has moved a box this frame, where each box was at the start of it
+    vector<uint64_t>        m_curveKeys; // the curve key of each box in the high half, its index in the low half
+    unsigned int            m_framesSinceReorder = 0;
 
     vector<CollisionPair>           m_collisionResults;
     vector<vector<CollisionPair>>   m_localCollisionResults;
+    vector<vector<CollisionPair>>   m_chunkCollisionResults; // one per chunk of the multi threaded all pairs loop
+
+    SpatialGrid             m_spatialGrid;
+    vector<unsigned int>    m_gridCandidates;
+
+    SweepAndPrune           m_sweepAndPrune;
+    DynamicAABBTree         m_aabbTree;
+    LBVH                    m_lbvh;
+    CellList                m_cellList;
+    NeighbourList           m_neighbourList;
+    HierarchicalGrid        m_hierarchicalGrid;
+
+    const CollisionKernels* m_simdKernels = &scalarCollisionKernels; // the best this CPU supports, picked in init
+    const CollisionKernels* m_kernels = &scalarCollisionKernels; // the kernels this frame uses (g_simd_kernels)
+    int                     m_predicate = predicate_aabb; // the collision test this frame uses (g_predicate)
+    unsigned int            m_pairCount = 0; // pairs resolved this frame
+
+    vector<CollisionPair>   m_emulatedCollisionPairs; // the compute shader's output buffer, for updateCollisionsCSEmulated
+    BoxSoA                  m_boxSoA = {}; // m_boxes' positions and radii, set by updateBoxSoA
+    PairSchedule            m_pairSchedule; // the pairs in levels for the batched resolve (g_batched_resolve)
+    CompactBoxes            m_compactBoxes;
+    bool                    m_useCompactBoxes = false; // this frame's row kernels use m_compactBoxes (g_compact_boxes)
+    bool                    m_uniformRadiusKernels = false; // this frame's row kernels use their one radius version
     
-    Microsoft::WRL::ComPtr <ID3D11ComputeShader> m_pComputeShader = nullptr; // the compute shader (CS)
+    Microsoft::WRL::ComPtr <ID3D11ComputeShader> m_pComputeShader[predicate_count]; // the compute shader (CS), for each collision test
+    unsigned int m_maxGPUCollisionPairs = 0; // the size of the collision pair buffer's view
+    unsigned int m_gpuBoxCapacity = 0; // the boxes the GPU buffers have room for
+    unsigned int m_gpuBoxCount = 0; // the boxes the views were made for
 
     Microsoft::WRL::ComPtr <ID3D11Buffer> m_pBoxBuffer = nullptr; // buffer box info will be passed into the CS
     Microsoft::WRL::ComPtr <ID3D11Buffer> m_pStagingBoxBuffer = nullptr; // a staging buffer to write frame by frame box data to (passed to the box gpu buffer)
@@ -0,0 +1,98 @@
+#include "CollisionKernels.h"
+#include <intrin.h>
+#include <immintrin.h>
+#include <algorithm>
+#include <climits>
+
+SimdLevel detectSimdLevel()
+{
+	int info[4];
+	__cpuid(info, 0);
+	const int maxLeaf = info[0];
+
+	__cpuid(info, 1);
+	const bool sse42 = (info[2] & (1 << 20)) != 0;
+	const bool avx = (info[2] & (1 << 28)) != 0;
+	const bool osxsave = (info[2] & (1 << 27)) != 0;
+	if (!sse42)
+		return SimdLevel::scalar;
+
+	// the OS has to save the YMM (and for AVX-512 the opmask and ZMM) registers on a context switch
+	if (!avx || !osxsave || maxLeaf < 7)
+		return SimdLevel::sse42;
+	const unsigned long long xcr0 = _xgetbv(0);
+	if ((xcr0 & 0x6) != 0x6)
+		return SimdLevel::sse42;
+
+	__cpuidex(info, 7, 0);
+	const bool avx2 = (info[1] & (1 << 5)) != 0;
+	const bool avx512f = (info[1] & (1 << 16)) != 0;
+	const bool avx512bw = (info[1] & (1 << 30)) != 0; // the 16 bit lanes of the compact kernels
+	if (!avx2)
+		return SimdLevel::sse42;
+
+	if (!avx512f || !avx512bw || (xcr0 & 0xe6) != 0xe6)
+		return SimdLevel::avx2;
+
+	return SimdLevel::avx512;
+}
+
+const CollisionKernels& getCollisionKernels(const SimdLevel level)
+{
+	switch (level)
+	{
+	case SimdLevel::avx512:
+		return avx512CollisionKernels;
+	case SimdLevel::avx2:
+		return avx2CollisionKernels;
+	case SimdLevel::sse42:
+		return sse42CollisionKernels;
+	default:
+		return scalarCollisionKernels;
+	}
+}
+
+void schedulePairs(const CollisionPair* pairs, const unsigned int count, const unsigned int numBoxes, PairSchedule& schedule)
+{
+	// the box levels are kept from call to call, with this call's levels counted from baseLevel, so a level from before
+	// is just one below it - setting them all back to 0 only when the count would run out
+	if (schedule.boxLevels.size() < numBoxes)
+		schedule.boxLevels.resize(numBoxes, 0);
+	if (schedule.baseLevel > UINT_MAX - count)
+	{
+		std::fill(schedule.boxLevels.begin(), schedule.boxLevels.end(), 0);
+		schedule.baseLevel = 0;
+	}
+	const unsigned int base = schedule.baseLevel;
+	schedule.pairLevels.resize(count);
+
+	// each pair's level, and how many pairs there are in each level (in the start of the level after)
+	schedule.levelStarts.assign(1, 0);
+	for (unsigned int k = 0; k < count; k++)
+	{
+		unsigned int& levelA = schedule.boxLevels[pairs[k].index1];
+		unsigned int& levelB = schedule.boxLevels[pairs[k].index2];
+		const unsigned int level = std::max(std::max(levelA, levelB), base);
+		levelA = level + 1;
+		levelB = level + 1;
+
+		const unsigned int index = level - base;
+		schedule.pairLevels[k] = index;
+		if (index + 1 == schedule.levelStarts.size())
+			schedule.levelStarts.push_back(0);
+		schedule.levelStarts[index + 1]++;
+	}
+	const unsigned int levelCount = (unsigned int)schedule.levelStarts.size() - 1;
+	schedule.baseLevel = base + levelCount;
+
+	// a counting sort by level, which keeps the list order within each level - each start is moved on as its level fills,
+	// so is left at the next level's start
+	for (unsigned int level = 0; level < levelCount; level++)
+		schedule.levelStarts[level + 1] += schedule.levelStarts[level];
+	schedule.pairs.resize(count);
+	for (unsigned int k = 0; k < count; k++)
+		schedule.pairs[schedule.levelStarts[schedule.pairLevels[k]]++] = pairs[k];
+	for (unsigned int level = levelCount; level > 0; level--)
+		schedule.levelStarts[level] = schedule.levelStarts[level - 1];
+	schedule.levelStarts[0] = 0;
+}
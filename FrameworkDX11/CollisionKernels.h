@@ -0,0 +1,197 @@
+// MIT License
+// Copyright (c) 2025 David White
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+
+// SIMD versions of the collision kernels, with the best version for this CPU picked at run time
+// The row kernels read the boxes as a structure of arrays (all the x's together, then the y's...) so one load fills
+// a register with the same component of several boxes, rather than one box's x, y, z and radius.
+// Each instruction set lives in its own .cpp, compiled with that instruction set enabled (see the project settings
+// for each file), and only ever called through the table getCollisionKernels returns - so one exe runs everywhere.
+// For that to hold, the AVX2 and AVX-512 files must not use any inline or template code with external linkage - a
+// vector's push_back, a predicate's overlaps - as the linker keeps one copy of each such function for the whole exe,
+// and it may be the one compiled for AVX. So the row kernels write to a buffer the caller grows the vector from, the
+// helpers below are static, and a table names the other files' kernels it shares rather than reading their tables.
+// The compact row kernels are the same again on the 16 bit quantized boxes (CompactBoxes.h), with integer compares
+// - twice the boxes per register, and a quarter of the memory to stream through for each row.
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <intrin.h>
+#include "Box.h"
+#include "BoxStore.h"
+#include "CollisionPredicates.h"
+
+using namespace std;
+
+// Pointers in to the box positions and radii - the BoxStore's own arrays
+// radius is null when every box is the same size, in which case that size is sharedRadius - the row kernels then have
+// a version that doesn't stream the radii at all, with the limit each pair is compared against worked out once per row
+struct BoxSoA {
+    const float*    x;
+    const float*    y;
+    const float*    z;
+    const float*    radius;
+    float           sharedRadius;
+    unsigned int    count;
+};
+
+// Pointers in to the quantized copy of the boxes - see CompactBoxes.h
+// radius is null when every box is the same size, in which case that size is sharedRadius
+struct CompactBoxSoA {
+    const uint16_t* x;
+    const uint16_t* y;
+    const uint16_t* z;
+    const uint16_t* radius;
+    uint16_t        sharedRadius;
+    unsigned int    count;
+};
+
+enum class SimdLevel {
+    scalar = 0,
+    sse42,
+    avx2,
+    avx512
+};
+
+// A row kernel tests box i against boxes [jBegin, jEnd), writes (i, j) for every overlap to pairs in j order (for the
+// first hit test, only the first overlap), and returns how many it wrote - pairs must have room for jEnd - jBegin
+typedef unsigned int (*RowKernel)(const BoxSoA& boxes, const unsigned int i, const unsigned int jBegin, const unsigned int jEnd, CollisionPair* pairs);
+typedef unsigned int (*CompactRowKernel)(const CompactBoxSoA& boxes, const unsigned int i, const unsigned int jBegin, const unsigned int jEnd, CollisionPair* pairs);
+
+// Every version gives the same answers as the scalar one: none of them use FMA, the sums are done in the same order,
+// and the kernel files are built with /fp:precise (the rest of the project is /fp:fast) so the compiler keeps it that way
+struct CollisionKernels {
+    const char*     name;
+
+    // the impulse between each pair, in order
+    void (*resolveCollisions)(const BoxArrays& boxes, const CollisionPair* pairs, const unsigned int count);
+    // resolveCollisions on a list from schedulePairs, a level at a time, with a register of the level's pairs resolved
+    // side by side - the same, as no pair in a level depends on another. Null where the registers are too narrow to be
+    // worth it. With exact false the normal is a multiply by 1 / length rather than three divides, which can be a bit
+    // out in the last place.
+    void (*resolveCollisionsBatched)(const BoxArrays& boxes, const CollisionPair* pairs, const unsigned int* levelStarts, const unsigned int levelCount, const bool exact);
+    // the row kernel for each collision test, indexed by predicate_aabb, predicate_sphere and predicate_first_hit
+    RowKernel       findOverlaps[predicate_count];
+    // the same on the quantized boxes - these all give the same answers too, but not quite the same as findOverlaps
+    CompactRowKernel findCompactOverlaps[predicate_count];
+    // ColliderManager::updateMovement - gravity, move and bounce off the floor and walls, for boxes [begin, end)
+    void (*integrate)(const BoxArrays& boxes, const unsigned int begin, const unsigned int end, const float deltaTime);
+};
+
+// A pair list put in to levels for resolveCollisionsBatched. A pair goes in the level after the last one either of its
+// boxes is in so far, so no two pairs in a level share a box, and each box's pairs come in the same order as in the list
+// - resolving the levels in turn gives exactly what resolving the list in order does, whatever the order within a level.
+// Kept between frames, so scheduling doesn't allocate once the vectors have grown.
+struct PairSchedule {
+    vector<CollisionPair>   pairs; // level by level
+    vector<unsigned int>    levelStarts; // where each level starts in pairs, then pairs.size()
+    vector<unsigned int>    pairLevels; // the level of each pair of the list
+    vector<unsigned int>    boxLevels; // the first level each box is free in, counting from baseLevel
+    unsigned int            baseLevel = 0; // the first level of the next call
+};
+
+// Sort count pairs of boxes [0, numBoxes) in to schedule's levels. Not an AVX2 kernel itself, as it uses the vectors.
+void schedulePairs(const CollisionPair* pairs, const unsigned int count, const unsigned int numBoxes, PairSchedule& schedule);
+
+extern const CollisionKernels scalarCollisionKernels;
+extern const CollisionKernels sse42CollisionKernels;
+extern const CollisionKernels avx2CollisionKernels;
+extern const CollisionKernels avx512CollisionKernels;
+
+// The kernels more than one table uses
+void resolveCollisionsScalar(const BoxArrays& boxes, const CollisionPair* pairs, const unsigned int count);
+void integrateSSE42(const BoxArrays& boxes, const unsigned int begin, const unsigned int end, const float deltaTime);
+void resolveCollisionsBatchedAVX2(const BoxArrays& boxes, const CollisionPair* pairs, const unsigned int* levelStarts, const unsigned int levelCount, const bool exact);
+
+// the widest instruction set this CPU and OS support
+SimdLevel detectSimdLevel();
+
+const CollisionKernels& getCollisionKernels(const SimdLevel level);
+
+// With one radius for every box, what every pair is compared against - the sum of the radii, or its square for the
+// sphere tests. The same sums the general kernels do for each pair, so the answers are the same.
+template <class Predicate>
+static inline float sharedRadiusLimit(const float radius)
+{
+    const float sumRadii = radius + radius;
+    return Predicate::sphereTest ? sumRadii * sumRadii : sumRadii;
+}
+
+// For the row kernels - adds (i, j + lane) to pairs, at count, for each bit set in a compare mask, or only the lowest bit
+// for a first hit test. Returns true when a first hit test has found its hit, so the row is finished.
+template <class Predicate>
+static inline bool appendHits(unsigned int mask, const unsigned int i, const unsigned int j, CollisionPair* pairs, unsigned int& count)
+{
+    if constexpr (Predicate::firstHitOnly)
+    {
+        if (!mask)
+            return false;
+
+        unsigned long lane;
+        _BitScanForward(&lane, mask);
+        pairs[count++] = { i, j + (unsigned int)lane };
+        return true;
+    }
+    else
+    {
+        // one bit per lane that hit, almost always zero
+        while (mask)
+        {
+            unsigned long lane;
+            _BitScanForward(&lane, mask);
+            pairs[count++] = { i, j + (unsigned int)lane };
+            mask &= mask - 1;
+        }
+        return false;
+    }
+}
+
+// The test between two of the quantized boxes, in integers, with the distances and radii in quantization steps.
+// Built from sphereTest, as the SIMD tests are - the sphere test in 64 bits, as the square of a 16 bit distance only
+// just fits in 32.
+template <class Predicate>
+static inline bool overlapsCompact(const CompactBoxSoA& boxes, const unsigned int i, const unsigned int j)
+{
+    const int dx = (int)boxes.x[i] - (int)boxes.x[j];
+    const int dy = (int)boxes.y[i] - (int)boxes.y[j];
+    const int dz = (int)boxes.z[i] - (int)boxes.z[j];
+    const int sumRadii = boxes.radius ? (int)boxes.radius[i] + (int)boxes.radius[j] : 2 * (int)boxes.sharedRadius;
+
+    if constexpr (Predicate::sphereTest)
+        return (long long)dx * dx + (long long)dy * dy + (long long)dz * dz < (long long)sumRadii * sumRadii;
+    else
+        return -sumRadii < dx && dx < sumRadii && -sumRadii < dy && dy < sumRadii && -sumRadii < dz && dz < sumRadii;
+}
+
+// For the compact row kernels, which only do the AABB test in SIMD - for the sphere tests each lane that passed it is
+// then checked on its own (a sphere overlap is always an AABB overlap, and only a few lanes ever pass).
+template <class Predicate>
+static inline bool appendCompactHits(unsigned int mask, const CompactBoxSoA& boxes, const unsigned int i, const unsigned int j, CollisionPair* pairs, unsigned int& count)
+{
+    if constexpr (Predicate::sphereTest)
+    {
+        unsigned int sphereMask = 0;
+        for (unsigned int candidates = mask; candidates; candidates &= candidates - 1)
+        {
+            unsigned long lane;
+            _BitScanForward(&lane, candidates);
+            if (overlapsCompact<Predicate>(boxes, i, j + (unsigned int)lane))
+                sphereMask |= 1u << lane;
+        }
+        mask = sphereMask;
+    }
+
+    return appendHits<Predicate>(mask, i, j, pairs, count);
+}
@@ -0,0 +1,297 @@
+// AVX2 versions of the kernels - 8 boxes per instruction in the row kernels (16 in the compact ones), 2 boxes per register in the integrator
+// Compiled with /arch:AVX2 (see the project settings for this file)
+// A pair's positions and velocities are spread over separate arrays, so resolveCollisions is the scalar one -
+// resolveCollisionsBatched gathers 8 pairs side by side instead
+
+#include "CollisionKernels.h"
+#include <cmath>
+#include <intrin.h>
+#include <immintrin.h>
+
+// Loads 8 floats, or with masked only the lanes set in valid (the rest are 0)
+template <bool masked>
+static inline __m256 loadLanesAVX2(const float* values, const __m256i valid)
+{
+	return masked ? _mm256_maskload_ps(values, valid) : _mm256_loadu_ps(values);
+}
+
+// The lanes of boxes [j, j + 8) that overlap box i - with masked, only those of the valid lanes are worth anything
+// With a shared radius, r1 is already the limit from sharedRadiusLimit and no radii are loaded
+template <class Predicate, bool sharedRadius, bool masked = false>
+static inline __m256 overlapLanesAVX2(const __m256 x1, const __m256 y1, const __m256 z1, const __m256 r1, const BoxSoA& boxes, const unsigned int j, const __m256i valid = __m256i())
+{
+	const __m256 dx = _mm256_sub_ps(x1, loadLanesAVX2<masked>(boxes.x + j, valid));
+	const __m256 dy = _mm256_sub_ps(y1, loadLanesAVX2<masked>(boxes.y + j, valid));
+	const __m256 dz = _mm256_sub_ps(z1, loadLanesAVX2<masked>(boxes.z + j, valid));
+	const __m256 sumRadii = sharedRadius ? r1 : _mm256_add_ps(r1, loadLanesAVX2<masked>(boxes.radius + j, valid));
+
+	if constexpr (Predicate::sphereTest)
+	{
+		// no FMA - keep the same rounding as the scalar x*x + y*y + z*z
+		const __m256 distSq = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+		return _mm256_cmp_ps(distSq, sharedRadius ? r1 : _mm256_mul_ps(sumRadii, sumRadii), _CMP_LT_OQ);
+	}
+	else
+	{
+		const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+		const __m256 overlapX = _mm256_cmp_ps(_mm256_and_ps(dx, absMask), sumRadii, _CMP_LT_OQ);
+		const __m256 overlapY = _mm256_cmp_ps(_mm256_and_ps(dy, absMask), sumRadii, _CMP_LT_OQ);
+		const __m256 overlapZ = _mm256_cmp_ps(_mm256_and_ps(dz, absMask), sumRadii, _CMP_LT_OQ);
+		return _mm256_and_ps(_mm256_and_ps(overlapX, overlapY), overlapZ);
+	}
+}
+
+template <class Predicate, bool sharedRadius>
+static unsigned int rowAVX2(const BoxSoA& boxes, const unsigned int i, const unsigned int jBegin, const unsigned int jEnd, CollisionPair* pairs)
+{
+	unsigned int count = 0;
+	const float ri = sharedRadius ? boxes.sharedRadius : boxes.radius[i];
+
+	const __m256 x1 = _mm256_set1_ps(boxes.x[i]);
+	const __m256 y1 = _mm256_set1_ps(boxes.y[i]);
+	const __m256 z1 = _mm256_set1_ps(boxes.z[i]);
+	const __m256 r1 = _mm256_set1_ps(sharedRadius ? sharedRadiusLimit<Predicate>(ri) : ri);
+
+	unsigned int j = jBegin;
+	for (; j + 8 <= jEnd; j += 8)
+	{
+		const unsigned int mask = (unsigned int)_mm256_movemask_ps(overlapLanesAVX2<Predicate, sharedRadius>(x1, y1, z1, r1, boxes, j));
+		if (appendHits<Predicate>(mask, i, j, pairs, count))
+			return count;
+	}
+
+	// the last few boxes that don't fill a register, with masked loads - the same sums as the full registers, and no
+	// call out to the scalar test (see CollisionKernels.h)
+	if (j < jEnd)
+	{
+		const unsigned int remaining = jEnd - j;
+		const __m256i valid = _mm256_cmpgt_epi32(_mm256_set1_epi32((int)remaining), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+		const unsigned int mask = (unsigned int)_mm256_movemask_ps(overlapLanesAVX2<Predicate, sharedRadius, true>(x1, y1, z1, r1, boxes, j, valid));
+		appendHits<Predicate>(mask & ((1u << remaining) - 1), i, j, pairs, count);
+	}
+	return count;
+}
+
+template <class Predicate>
+static unsigned int findOverlapsAVX2(const BoxSoA& boxes, const unsigned int i, const unsigned int jBegin, const unsigned int jEnd, CollisionPair* pairs)
+{
+	if (boxes.radius)
+		return rowAVX2<Predicate, false>(boxes, i, jBegin, jEnd, pairs);
+	return rowAVX2<Predicate, true>(boxes, i, jBegin, jEnd, pairs);
+}
+
+// As compactOverlapLanesSSE42, for boxes [j, j + 16)
+template <bool sharedRadius>
+static inline unsigned int compactOverlapLanesAVX2(const __m256i x1, const __m256i y1, const __m256i z1, const __m256i r1, const CompactBoxSoA& boxes, const unsigned int j)
+{
+	const __m256i x2 = _mm256_loadu_si256((const __m256i*)(boxes.x + j));
+	const __m256i y2 = _mm256_loadu_si256((const __m256i*)(boxes.y + j));
+	const __m256i z2 = _mm256_loadu_si256((const __m256i*)(boxes.z + j));
+	const __m256i sumRadii = sharedRadius ? r1 : _mm256_adds_epu16(r1, _mm256_loadu_si256((const __m256i*)(boxes.radius + j)));
+
+	const __m256i dx = _mm256_or_si256(_mm256_subs_epu16(x1, x2), _mm256_subs_epu16(x2, x1));
+	const __m256i dy = _mm256_or_si256(_mm256_subs_epu16(y1, y2), _mm256_subs_epu16(y2, y1));
+	const __m256i dz = _mm256_or_si256(_mm256_subs_epu16(z1, z2), _mm256_subs_epu16(z2, z1));
+	const __m256i inside = _mm256_min_epu16(_mm256_min_epu16(_mm256_subs_epu16(sumRadii, dx), _mm256_subs_epu16(sumRadii, dy)), _mm256_subs_epu16(sumRadii, dz));
+
+	// the pack works within each 128 bit half, so lanes 0-7 land in bits 0-7 and lanes 8-15 in bits 16-23
+	const __m256i outside = _mm256_cmpeq_epi16(inside, _mm256_setzero_si256());
+	const unsigned int bytes = (unsigned int)_mm256_movemask_epi8(_mm256_packs_epi16(outside, outside));
+	return ~((bytes & 0xff) | ((bytes >> 8) & 0xff00)) & 0xffff;
+}
+
+template <class Predicate, bool sharedRadius>
+static unsigned int compactRowAVX2(const CompactBoxSoA& boxes, const unsigned int i, const unsigned int jBegin, const unsigned int jEnd, CollisionPair* pairs)
+{
+	unsigned int count = 0;
+	const __m256i x1 = _mm256_set1_epi16((short)boxes.x[i]);
+	const __m256i y1 = _mm256_set1_epi16((short)boxes.y[i]);
+	const __m256i z1 = _mm256_set1_epi16((short)boxes.z[i]);
+	const __m256i r1 = _mm256_set1_epi16((short)(sharedRadius ? 2 * boxes.sharedRadius : boxes.radius[i]));
+
+	unsigned int j = jBegin;
+	for (; j + 16 <= jEnd; j += 16)
+	{
+		const unsigned int mask = compactOverlapLanesAVX2<sharedRadius>(x1, y1, z1, r1, boxes, j);
+		if (mask && appendCompactHits<Predicate>(mask, boxes, i, j, pairs, count))
+			return count;
+	}
+
+	// the last few boxes that don't fill a register
+	for (; j < jEnd; j++)
+	{
+		if (overlapsCompact<Predicate>(boxes, i, j))
+		{
+			pairs[count++] = { i, j };
+			if (Predicate::firstHitOnly)
+				break;
+		}
+	}
+	return count;
+}
+
+template <class Predicate>
+static unsigned int findCompactOverlapsAVX2(const CompactBoxSoA& boxes, const unsigned int i, const unsigned int jBegin, const unsigned int jEnd, CollisionPair* pairs)
+{
+	if (boxes.radius)
+		return compactRowAVX2<Predicate, false>(boxes, i, jBegin, jEnd, pairs);
+	return compactRowAVX2<Predicate, true>(boxes, i, jBegin, jEnd, pairs);
+}
+
+// The first (or second) box of each of pairs [0, 8)
+static inline __m256i pairBoxesAVX2(const CollisionPair* pairs, const bool second)
+{
+	const __m256i lanes = second ? _mm256_setr_epi32(1, 3, 5, 7, 0, 2, 4, 6) : _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+	const __m256i low = _mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i*)pairs), lanes);
+	const __m256i high = _mm256_permutevar8x32_epi32(_mm256_loadu_si256((const __m256i*)(pairs + 4)), lanes);
+	return _mm256_permute2x128_si256(low, high, 0x20);
+}
+
+// There is no scatter in AVX2, so each lane is written back on its own
+static inline void storeLanesAVX2(float* array, const __m256i boxIndices, const __m256 values)
+{
+	alignas(32) unsigned int indices[8];
+	alignas(32) float lanes[8];
+	_mm256_store_si256((__m256i*)indices, boxIndices);
+	_mm256_store_ps(lanes, values);
+	for (int lane = 0; lane < 8; lane++)
+		array[indices[lane]] = lanes[lane];
+}
+
+// resolveCollisionScalar for pairs [0, 8), side by side, one pair per lane - the same as one after another, as long as
+// no two of them share a box. The same operations in the same order as the scalar code, so with exact set the velocities
+// come out the same to the bit.
+template <bool exact>
+static inline void resolveLanesAVX2(const BoxArrays& boxes, const CollisionPair* pairs)
+{
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 restitution = _mm256_set1_ps(-(1.0f + 0.01f)); // as resolveCollisionScalar
+	const __m256 dampening = _mm256_set1_ps(0.9f);
+
+	const __m256i boxA = pairBoxesAVX2(pairs, false);
+	const __m256i boxB = pairBoxesAVX2(pairs, true);
+
+	__m256 nx = _mm256_sub_ps(_mm256_i32gather_ps(boxes.x, boxA, 4), _mm256_i32gather_ps(boxes.x, boxB, 4));
+	__m256 ny = _mm256_sub_ps(_mm256_i32gather_ps(boxes.y, boxA, 4), _mm256_i32gather_ps(boxes.y, boxB, 4));
+	__m256 nz = _mm256_sub_ps(_mm256_i32gather_ps(boxes.z, boxA, 4), _mm256_i32gather_ps(boxes.z, boxB, 4));
+
+	const __m256 length = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, nx), _mm256_mul_ps(ny, ny)), _mm256_mul_ps(nz, nz)));
+	const __m256 hasLength = _mm256_cmp_ps(length, zero, _CMP_GT_OQ);
+	if (exact)
+	{
+		nx = _mm256_blendv_ps(nx, _mm256_div_ps(nx, length), hasLength);
+		ny = _mm256_blendv_ps(ny, _mm256_div_ps(ny, length), hasLength);
+		nz = _mm256_blendv_ps(nz, _mm256_div_ps(nz, length), hasLength);
+	}
+	else
+	{
+		const __m256 invLength = _mm256_div_ps(_mm256_set1_ps(1.0f), length);
+		nx = _mm256_blendv_ps(nx, _mm256_mul_ps(nx, invLength), hasLength);
+		ny = _mm256_blendv_ps(ny, _mm256_mul_ps(ny, invLength), hasLength);
+		nz = _mm256_blendv_ps(nz, _mm256_mul_ps(nz, invLength), hasLength);
+	}
+
+	const __m256 vax = _mm256_i32gather_ps(boxes.vx, boxA, 4);
+	const __m256 vay = _mm256_i32gather_ps(boxes.vy, boxA, 4);
+	const __m256 vaz = _mm256_i32gather_ps(boxes.vz, boxA, 4);
+	const __m256 vbx = _mm256_i32gather_ps(boxes.vx, boxB, 4);
+	const __m256 vby = _mm256_i32gather_ps(boxes.vy, boxB, 4);
+	const __m256 vbz = _mm256_i32gather_ps(boxes.vz, boxB, 4);
+
+	// relative velocity along the normal - the lanes moving apart are left alone (NaN lanes are resolved, as in
+	// the scalar code, which only skips impulse > 0)
+	const __m256 impulse = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(vax, vbx), nx), _mm256_mul_ps(_mm256_sub_ps(vay, vby), ny)),
+		_mm256_mul_ps(_mm256_sub_ps(vaz, vbz), nz));
+	const __m256 resolve = _mm256_cmp_ps(impulse, zero, _CMP_NGT_UQ);
+	if (_mm256_movemask_ps(resolve) == 0)
+		return;
+
+	const __m256 j = _mm256_mul_ps(_mm256_mul_ps(restitution, impulse), dampening);
+	const __m256 cx = _mm256_mul_ps(j, nx);
+	const __m256 cy = _mm256_mul_ps(j, ny);
+	const __m256 cz = _mm256_mul_ps(j, nz);
+
+	// every lane is written back, the ones left alone unchanged
+	storeLanesAVX2(boxes.vx, boxA, _mm256_blendv_ps(vax, _mm256_add_ps(vax, cx), resolve));
+	storeLanesAVX2(boxes.vy, boxA, _mm256_blendv_ps(vay, _mm256_add_ps(vay, cy), resolve));
+	storeLanesAVX2(boxes.vz, boxA, _mm256_blendv_ps(vaz, _mm256_add_ps(vaz, cz), resolve));
+	storeLanesAVX2(boxes.vx, boxB, _mm256_blendv_ps(vbx, _mm256_sub_ps(vbx, cx), resolve));
+	storeLanesAVX2(boxes.vy, boxB, _mm256_blendv_ps(vby, _mm256_sub_ps(vby, cy), resolve));
+	storeLanesAVX2(boxes.vz, boxB, _mm256_blendv_ps(vbz, _mm256_sub_ps(vbz, cz), resolve));
+}
+
+// Each level a register of pairs at a time, and the last few that don't fill one one at a time
+template <bool exact>
+static void resolveLevelsAVX2(const BoxArrays& boxes, const CollisionPair* pairs, const unsigned int* levelStarts, const unsigned int levelCount)
+{
+	for (unsigned int level = 0; level < levelCount; level++)
+	{
+		unsigned int k = levelStarts[level];
+		const unsigned int end = levelStarts[level + 1];
+		for (; k + 8 <= end; k += 8)
+			resolveLanesAVX2<exact>(boxes, pairs + k);
+		resolveCollisionsScalar(boxes, pairs + k, end - k);
+	}
+}
+
+void resolveCollisionsBatchedAVX2(const BoxArrays& boxes, const CollisionPair* pairs, const unsigned int* levelStarts, const unsigned int levelCount, const bool exact)
+{
+	if (exact)
+		resolveLevelsAVX2<true>(boxes, pairs, levelStarts, levelCount);
+	else
+		resolveLevelsAVX2<false>(boxes, pairs, levelStarts, levelCount);
+}
+
+// As integrateSSE42, eight boxes at a time
+static void integrateAVX2(const BoxArrays& boxes, const unsigned int begin, const unsigned int end, const float deltaTime)
+{
+	const __m256 gravityStep = _mm256_set1_ps(gravity * deltaTime);
+	const __m256 dt = _mm256_set1_ps(deltaTime);
+	const __m256 floorY = _mm256_set1_ps(minY);
+	const __m256 wallMinX = _mm256_set1_ps(minX);
+	const __m256 wallMaxX = _mm256_set1_ps(maxX);
+	const __m256 wallMinZ = _mm256_set1_ps(minZ);
+	const __m256 wallMaxZ = _mm256_set1_ps(maxZ);
+	const __m256 floorBounce = _mm256_set1_ps(-0.7f);
+	const __m256 signBit = _mm256_set1_ps(-0.0f);
+
+	unsigned int i = begin;
+	for (; i + 8 <= end; i += 8)
+	{
+		const __m256 radius = _mm256_loadu_ps(boxes.radius + i);
+		__m256 vx = _mm256_loadu_ps(boxes.vx + i);
+		__m256 vy = _mm256_add_ps(_mm256_loadu_ps(boxes.vy + i), gravityStep);
+		__m256 vz = _mm256_loadu_ps(boxes.vz + i);
+		const __m256 x = _mm256_add_ps(_mm256_loadu_ps(boxes.x + i), _mm256_mul_ps(vx, dt));
+		__m256 y = _mm256_add_ps(_mm256_loadu_ps(boxes.y + i), _mm256_mul_ps(vy, dt));
+		const __m256 z = _mm256_add_ps(_mm256_loadu_ps(boxes.z + i), _mm256_mul_ps(vz, dt));
+
+		const __m256 onFloor = _mm256_cmp_ps(_mm256_sub_ps(y, radius), floorY, _CMP_LT_OQ);
+		y = _mm256_blendv_ps(y, _mm256_add_ps(floorY, radius), onFloor);
+		vy = _mm256_blendv_ps(vy, _mm256_mul_ps(vy, floorBounce), onFloor);
+
+		const __m256 wallX = _mm256_or_ps(_mm256_cmp_ps(_mm256_sub_ps(x, radius), wallMinX, _CMP_LT_OQ), _mm256_cmp_ps(_mm256_add_ps(x, radius), wallMaxX, _CMP_GT_OQ));
+		const __m256 wallZ = _mm256_or_ps(_mm256_cmp_ps(_mm256_sub_ps(z, radius), wallMinZ, _CMP_LT_OQ), _mm256_cmp_ps(_mm256_add_ps(z, radius), wallMaxZ, _CMP_GT_OQ));
+		vx = _mm256_xor_ps(vx, _mm256_and_ps(wallX, signBit));
+		vz = _mm256_xor_ps(vz, _mm256_and_ps(wallZ, signBit));
+
+		_mm256_storeu_ps(boxes.x + i, x);
+		_mm256_storeu_ps(boxes.y + i, y);
+		_mm256_storeu_ps(boxes.z + i, z);
+		_mm256_storeu_ps(boxes.vx + i, vx);
+		_mm256_storeu_ps(boxes.vy + i, vy);
+		_mm256_storeu_ps(boxes.vz + i, vz);
+	}
+
+	if (i < end)
+		integrateSSE42(boxes, i, end, deltaTime);
+}
+
+const CollisionKernels avx2CollisionKernels = {
+	"AVX2",
+	resolveCollisionsScalar,
+	resolveCollisionsBatchedAVX2,
+	{ findOverlapsAVX2<AABBPredicate>, findOverlapsAVX2<SpherePredicate>, findOverlapsAVX2<FirstHitPredicate> },
+	{ findCompactOverlapsAVX2<AABBPredicate>, findCompactOverlapsAVX2<SpherePredicate>, findCompactOverlapsAVX2<FirstHitPredicate> },
+	integrateAVX2
+};
@@ -0,0 +1,195 @@
+// AVX-512 versions of the kernels - 16 boxes per instruction in the row kernels and the integrator (32 in the compact ones)
+// Compiled with /arch:AVX512 (see the project settings for this file)
+// The rows finish with a masked load and compare, so there is no scalar tail, and the pairs are written with compress
+// stores rather than one at a time
+
+#include "CollisionKernels.h"
+#include <intrin.h>
+#include <immintrin.h>
+
+// the lanes of a 16 wide register that are before jEnd
+static inline __mmask16 validLanes(const unsigned int j, const unsigned int jEnd)
+{
+	const unsigned int remaining = jEnd - j;
+	return remaining >= 16 ? (__mmask16)0xffff : (__mmask16)((1u << remaining) - 1);
+}
+
+// Writes (i, j + lane) to pairs, at count, for each lane set in hit, in lane order - compress-stored (vpcompressq) a
+// register of pairs at a time, so there is no branch per hit. In a dense pile the hit rate is high enough for a branch
+// per hit to be the bottleneck.
+static inline void compressPairs(const __m512i iLanes, const __mmask16 hit, const unsigned int j, CollisionPair* pairs, unsigned int& count)
+{
+	// a CollisionPair is 64 bits - i in the low half, j in the high half - so 8 to a register
+	const __m512i jLanes = _mm512_add_epi32(_mm512_set1_epi32(j), _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+	const __m512i low = _mm512_or_si512(_mm512_slli_epi64(_mm512_cvtepu32_epi64(_mm512_castsi512_si256(jLanes)), 32), iLanes);
+	const __m512i high = _mm512_or_si512(_mm512_slli_epi64(_mm512_cvtepu32_epi64(_mm512_extracti64x4_epi64(jLanes, 1)), 32), iLanes);
+
+	_mm512_mask_compressstoreu_epi64(pairs + count, (__mmask8)hit, low);
+	count += _mm_popcnt_u32(hit & 0xff);
+	_mm512_mask_compressstoreu_epi64(pairs + count, (__mmask8)(hit >> 8), high);
+	count += _mm_popcnt_u32(hit >> 8);
+}
+
+// The lanes of boxes [j, j + 16) that overlap box i, out of the valid ones
+// With a shared radius, r1 is already the limit from sharedRadiusLimit and no radii are loaded
+template <class Predicate, bool sharedRadius>
+static inline __mmask16 overlapLanesAVX512(const __m512 x1, const __m512 y1, const __m512 z1, const __m512 r1, const BoxSoA& boxes, const unsigned int j, const __mmask16 valid)
+{
+	const __m512 dx = _mm512_sub_ps(x1, _mm512_maskz_loadu_ps(valid, boxes.x + j));
+	const __m512 dy = _mm512_sub_ps(y1, _mm512_maskz_loadu_ps(valid, boxes.y + j));
+	const __m512 dz = _mm512_sub_ps(z1, _mm512_maskz_loadu_ps(valid, boxes.z + j));
+	const __m512 sumRadii = sharedRadius ? r1 : _mm512_add_ps(r1, _mm512_maskz_loadu_ps(valid, boxes.radius + j));
+
+	if constexpr (Predicate::sphereTest)
+	{
+		const __m512 distSq = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(dx, dx), _mm512_mul_ps(dy, dy)), _mm512_mul_ps(dz, dz));
+		return _mm512_mask_cmp_ps_mask(valid, distSq, sharedRadius ? r1 : _mm512_mul_ps(sumRadii, sumRadii), _CMP_LT_OQ);
+	}
+	else
+	{
+		// each compare only looks at the lanes still in the running
+		__mmask16 hit = _mm512_mask_cmp_ps_mask(valid, _mm512_abs_ps(dx), sumRadii, _CMP_LT_OQ);
+		hit = _mm512_mask_cmp_ps_mask(hit, _mm512_abs_ps(dy), sumRadii, _CMP_LT_OQ);
+		return _mm512_mask_cmp_ps_mask(hit, _mm512_abs_ps(dz), sumRadii, _CMP_LT_OQ);
+	}
+}
+
+template <class Predicate, bool sharedRadius>
+static unsigned int rowAVX512(const BoxSoA& boxes, const unsigned int i, const unsigned int jBegin, const unsigned int jEnd, CollisionPair* pairs)
+{
+	unsigned int count = 0;
+	const __m512 x1 = _mm512_set1_ps(boxes.x[i]);
+	const __m512 y1 = _mm512_set1_ps(boxes.y[i]);
+	const __m512 z1 = _mm512_set1_ps(boxes.z[i]);
+	const __m512 r1 = _mm512_set1_ps(sharedRadius ? sharedRadiusLimit<Predicate>(boxes.sharedRadius) : boxes.radius[i]);
+
+	if constexpr (Predicate::firstHitOnly)
+	{
+		for (unsigned int j = jBegin; j < jEnd; j += 16)
+		{
+			const __mmask16 hit = overlapLanesAVX512<Predicate, sharedRadius>(x1, y1, z1, r1, boxes, j, validLanes(j, jEnd));
+			if (appendHits<Predicate>(hit, i, j, pairs, count))
+				break;
+		}
+	}
+	else
+	{
+		const __m512i iLanes = _mm512_set1_epi64(i);
+		for (unsigned int j = jBegin; j < jEnd; j += 16)
+		{
+			const __mmask16 hit = overlapLanesAVX512<Predicate, sharedRadius>(x1, y1, z1, r1, boxes, j, validLanes(j, jEnd));
+			if (hit)
+				compressPairs(iLanes, hit, j, pairs, count);
+		}
+	}
+	return count;
+}
+
+template <class Predicate>
+static unsigned int findOverlapsAVX512(const BoxSoA& boxes, const unsigned int i, const unsigned int jBegin, const unsigned int jEnd, CollisionPair* pairs)
+{
+	if (boxes.radius)
+		return rowAVX512<Predicate, false>(boxes, i, jBegin, jEnd, pairs);
+	return rowAVX512<Predicate, true>(boxes, i, jBegin, jEnd, pairs);
+}
+
+// The lanes of boxes [j, j + 32) whose AABBs overlap box i, on the quantized boxes - AVX-512 has unsigned 16 bit compares
+template <bool sharedRadius>
+static inline __mmask32 compactOverlapLanesAVX512(const __m512i x1, const __m512i y1, const __m512i z1, const __m512i r1, const CompactBoxSoA& boxes, const unsigned int j, const __mmask32 valid)
+{
+	const __m512i x2 = _mm512_maskz_loadu_epi16(valid, boxes.x + j);
+	const __m512i y2 = _mm512_maskz_loadu_epi16(valid, boxes.y + j);
+	const __m512i z2 = _mm512_maskz_loadu_epi16(valid, boxes.z + j);
+	const __m512i sumRadii = sharedRadius ? r1 : _mm512_adds_epu16(r1, _mm512_maskz_loadu_epi16(valid, boxes.radius + j));
+
+	const __m512i dx = _mm512_sub_epi16(_mm512_max_epu16(x1, x2), _mm512_min_epu16(x1, x2));
+	const __m512i dy = _mm512_sub_epi16(_mm512_max_epu16(y1, y2), _mm512_min_epu16(y1, y2));
+	const __m512i dz = _mm512_sub_epi16(_mm512_max_epu16(z1, z2), _mm512_min_epu16(z1, z2));
+
+	__mmask32 hit = _mm512_mask_cmplt_epu16_mask(valid, dx, sumRadii);
+	hit = _mm512_mask_cmplt_epu16_mask(hit, dy, sumRadii);
+	return _mm512_mask_cmplt_epu16_mask(hit, dz, sumRadii);
+}
+
+template <class Predicate, bool sharedRadius>
+static unsigned int compactRowAVX512(const CompactBoxSoA& boxes, const unsigned int i, const unsigned int jBegin, const unsigned int jEnd, CollisionPair* pairs)
+{
+	unsigned int count = 0;
+	const __m512i x1 = _mm512_set1_epi16((short)boxes.x[i]);
+	const __m512i y1 = _mm512_set1_epi16((short)boxes.y[i]);
+	const __m512i z1 = _mm512_set1_epi16((short)boxes.z[i]);
+	const __m512i r1 = _mm512_set1_epi16((short)(sharedRadius ? 2 * boxes.sharedRadius : boxes.radius[i]));
+
+	for (unsigned int j = jBegin; j < jEnd; j += 32)
+	{
+		const unsigned int remaining = jEnd - j;
+		const __mmask32 valid = remaining >= 32 ? (__mmask32)0xffffffff : (__mmask32)((1u << remaining) - 1);
+
+		const __mmask32 hit = compactOverlapLanesAVX512<sharedRadius>(x1, y1, z1, r1, boxes, j, valid);
+		if (hit && appendCompactHits<Predicate>(hit, boxes, i, j, pairs, count))
+			break;
+	}
+	return count;
+}
+
+template <class Predicate>
+static unsigned int findCompactOverlapsAVX512(const CompactBoxSoA& boxes, const unsigned int i, const unsigned int jBegin, const unsigned int jEnd, CollisionPair* pairs)
+{
+	if (boxes.radius)
+		return compactRowAVX512<Predicate, false>(boxes, i, jBegin, jEnd, pairs);
+	return compactRowAVX512<Predicate, true>(boxes, i, jBegin, jEnd, pairs);
+}
+
+// As integrateSSE42, sixteen boxes at a time - the last few with masked loads and stores
+static void integrateAVX512(const BoxArrays& boxes, const unsigned int begin, const unsigned int end, const float deltaTime)
+{
+	const __m512 gravityStep = _mm512_set1_ps(gravity * deltaTime);
+	const __m512 dt = _mm512_set1_ps(deltaTime);
+	const __m512 floorY = _mm512_set1_ps(minY);
+	const __m512 wallMinX = _mm512_set1_ps(minX);
+	const __m512 wallMaxX = _mm512_set1_ps(maxX);
+	const __m512 wallMinZ = _mm512_set1_ps(minZ);
+	const __m512 wallMaxZ = _mm512_set1_ps(maxZ);
+	const __m512 floorBounce = _mm512_set1_ps(-0.7f);
+	const __m512i signBit = _mm512_set1_epi32(0x80000000);
+
+	for (unsigned int i = begin; i < end; i += 16)
+	{
+		const __mmask16 valid = validLanes(i, end);
+
+		const __m512 radius = _mm512_maskz_loadu_ps(valid, boxes.radius + i);
+		__m512 vx = _mm512_maskz_loadu_ps(valid, boxes.vx + i);
+		__m512 vy = _mm512_add_ps(_mm512_maskz_loadu_ps(valid, boxes.vy + i), gravityStep);
+		__m512 vz = _mm512_maskz_loadu_ps(valid, boxes.vz + i);
+		const __m512 x = _mm512_add_ps(_mm512_maskz_loadu_ps(valid, boxes.x + i), _mm512_mul_ps(vx, dt));
+		__m512 y = _mm512_add_ps(_mm512_maskz_loadu_ps(valid, boxes.y + i), _mm512_mul_ps(vy, dt));
+		const __m512 z = _mm512_add_ps(_mm512_maskz_loadu_ps(valid, boxes.z + i), _mm512_mul_ps(vz, dt));
+
+		const __mmask16 onFloor = _mm512_cmp_ps_mask(_mm512_sub_ps(y, radius), floorY, _CMP_LT_OQ);
+		y = _mm512_mask_add_ps(y, onFloor, floorY, radius);
+		vy = _mm512_mask_mul_ps(vy, onFloor, vy, floorBounce);
+
+		const __mmask16 wallX = _mm512_cmp_ps_mask(_mm512_sub_ps(x, radius), wallMinX, _CMP_LT_OQ) |
+			_mm512_cmp_ps_mask(_mm512_add_ps(x, radius), wallMaxX, _CMP_GT_OQ);
+		const __mmask16 wallZ = _mm512_cmp_ps_mask(_mm512_sub_ps(z, radius), wallMinZ, _CMP_LT_OQ) |
+			_mm512_cmp_ps_mask(_mm512_add_ps(z, radius), wallMaxZ, _CMP_GT_OQ);
+		vx = _mm512_castsi512_ps(_mm512_mask_xor_epi32(_mm512_castps_si512(vx), wallX, _mm512_castps_si512(vx), signBit));
+		vz = _mm512_castsi512_ps(_mm512_mask_xor_epi32(_mm512_castps_si512(vz), wallZ, _mm512_castps_si512(vz), signBit));
+
+		_mm512_mask_storeu_ps(boxes.x + i, valid, x);
+		_mm512_mask_storeu_ps(boxes.y + i, valid, y);
+		_mm512_mask_storeu_ps(boxes.z + i, valid, z);
+		_mm512_mask_storeu_ps(boxes.vx + i, valid, vx);
+		_mm512_mask_storeu_ps(boxes.vy + i, valid, vy);
+		_mm512_mask_storeu_ps(boxes.vz + i, valid, vz);
+	}
+}
+
+const CollisionKernels avx512CollisionKernels = {
+	"AVX-512",
+	resolveCollisionsScalar,
+	resolveCollisionsBatchedAVX2,
+	{ findOverlapsAVX512<AABBPredicate>, findOverlapsAVX512<SpherePredicate>, findOverlapsAVX512<FirstHitPredicate> },
+	{ findCompactOverlapsAVX512<AABBPredicate>, findCompactOverlapsAVX512<SpherePredicate>, findCompactOverlapsAVX512<FirstHitPredicate> },
+	integrateAVX512
+};
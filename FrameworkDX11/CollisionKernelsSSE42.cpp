@@ -0,0 +1,194 @@
+// SSE4.2 versions of the kernels - 4 boxes per instruction in the row kernels and the integrator (8 in the compact ones)
+// (no compiler switch needed, the x64 compiler always accepts SSE intrinsics)
+// A pair's positions and velocities are spread over separate arrays, so there is nothing to fill a register with in the
+// resolve - that is the scalar one
+
+#include "CollisionKernels.h"
+#include <cmath>
+#include <intrin.h>
+#include <smmintrin.h>
+
+// The lanes of boxes [j, j + 4) that overlap box i
+// With a shared radius, r1 is already the limit from sharedRadiusLimit and no radii are loaded
+template <class Predicate, bool sharedRadius>
+static inline __m128 overlapLanesSSE42(const __m128 x1, const __m128 y1, const __m128 z1, const __m128 r1, const BoxSoA& boxes, const unsigned int j)
+{
+	const __m128 dx = _mm_sub_ps(x1, _mm_loadu_ps(boxes.x + j));
+	const __m128 dy = _mm_sub_ps(y1, _mm_loadu_ps(boxes.y + j));
+	const __m128 dz = _mm_sub_ps(z1, _mm_loadu_ps(boxes.z + j));
+	const __m128 sumRadii = sharedRadius ? r1 : _mm_add_ps(r1, _mm_loadu_ps(boxes.radius + j));
+
+	if constexpr (Predicate::sphereTest)
+	{
+		const __m128 distSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+		return _mm_cmplt_ps(distSq, sharedRadius ? r1 : _mm_mul_ps(sumRadii, sumRadii));
+	}
+	else
+	{
+		const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+		const __m128 overlapX = _mm_cmplt_ps(_mm_and_ps(dx, absMask), sumRadii);
+		const __m128 overlapY = _mm_cmplt_ps(_mm_and_ps(dy, absMask), sumRadii);
+		const __m128 overlapZ = _mm_cmplt_ps(_mm_and_ps(dz, absMask), sumRadii);
+		return _mm_and_ps(_mm_and_ps(overlapX, overlapY), overlapZ);
+	}
+}
+
+template <class Predicate, bool sharedRadius>
+static unsigned int rowSSE42(const BoxSoA& boxes, const unsigned int i, const unsigned int jBegin, const unsigned int jEnd, CollisionPair* pairs)
+{
+	unsigned int count = 0;
+	const float xi = boxes.x[i];
+	const float yi = boxes.y[i];
+	const float zi = boxes.z[i];
+	const float ri = sharedRadius ? boxes.sharedRadius : boxes.radius[i];
+
+	const __m128 x1 = _mm_set1_ps(xi);
+	const __m128 y1 = _mm_set1_ps(yi);
+	const __m128 z1 = _mm_set1_ps(zi);
+	const __m128 r1 = _mm_set1_ps(sharedRadius ? sharedRadiusLimit<Predicate>(ri) : ri);
+
+	unsigned int j = jBegin;
+	for (; j + 4 <= jEnd; j += 4)
+	{
+		const unsigned int mask = (unsigned int)_mm_movemask_ps(overlapLanesSSE42<Predicate, sharedRadius>(x1, y1, z1, r1, boxes, j));
+		if (appendHits<Predicate>(mask, i, j, pairs, count))
+			return count;
+	}
+
+	// the last few boxes that don't fill a register
+	for (; j < jEnd; j++)
+	{
+		if (Predicate::overlaps(xi, yi, zi, ri, boxes.x[j], boxes.y[j], boxes.z[j], sharedRadius ? ri : boxes.radius[j]))
+		{
+			pairs[count++] = { i, j };
+			if (Predicate::firstHitOnly)
+				break;
+		}
+	}
+	return count;
+}
+
+template <class Predicate>
+static unsigned int findOverlapsSSE42(const BoxSoA& boxes, const unsigned int i, const unsigned int jBegin, const unsigned int jEnd, CollisionPair* pairs)
+{
+	if (boxes.radius)
+		return rowSSE42<Predicate, false>(boxes, i, jBegin, jEnd, pairs);
+	return rowSSE42<Predicate, true>(boxes, i, jBegin, jEnd, pairs);
+}
+
+// The lanes of boxes [j, j + 8) whose AABBs overlap box i, on the quantized boxes
+// There is no unsigned 16 bit compare, but with saturating subtracts |a - b| is (a -sat b) | (b -sat a), and
+// d < r is (r -sat d) != 0 - so a lane overlaps when the smallest of those, over the three axes, isn't zero.
+template <bool sharedRadius>
+static inline unsigned int compactOverlapLanesSSE42(const __m128i x1, const __m128i y1, const __m128i z1, const __m128i r1, const CompactBoxSoA& boxes, const unsigned int j)
+{
+	const __m128i x2 = _mm_loadu_si128((const __m128i*)(boxes.x + j));
+	const __m128i y2 = _mm_loadu_si128((const __m128i*)(boxes.y + j));
+	const __m128i z2 = _mm_loadu_si128((const __m128i*)(boxes.z + j));
+	const __m128i sumRadii = sharedRadius ? r1 : _mm_adds_epu16(r1, _mm_loadu_si128((const __m128i*)(boxes.radius + j)));
+
+	const __m128i dx = _mm_or_si128(_mm_subs_epu16(x1, x2), _mm_subs_epu16(x2, x1));
+	const __m128i dy = _mm_or_si128(_mm_subs_epu16(y1, y2), _mm_subs_epu16(y2, y1));
+	const __m128i dz = _mm_or_si128(_mm_subs_epu16(z1, z2), _mm_subs_epu16(z2, z1));
+	const __m128i inside = _mm_min_epu16(_mm_min_epu16(_mm_subs_epu16(sumRadii, dx), _mm_subs_epu16(sumRadii, dy)), _mm_subs_epu16(sumRadii, dz));
+
+	// one byte per lane, then one bit
+	const __m128i outside = _mm_cmpeq_epi16(inside, _mm_setzero_si128());
+	return ~(unsigned int)_mm_movemask_epi8(_mm_packs_epi16(outside, outside)) & 0xff;
+}
+
+template <class Predicate, bool sharedRadius>
+static unsigned int compactRowSSE42(const CompactBoxSoA& boxes, const unsigned int i, const unsigned int jBegin, const unsigned int jEnd, CollisionPair* pairs)
+{
+	unsigned int count = 0;
+	const __m128i x1 = _mm_set1_epi16((short)boxes.x[i]);
+	const __m128i y1 = _mm_set1_epi16((short)boxes.y[i]);
+	const __m128i z1 = _mm_set1_epi16((short)boxes.z[i]);
+	// with a shared radius this is already the sum of the two radii
+	const __m128i r1 = _mm_set1_epi16((short)(sharedRadius ? 2 * boxes.sharedRadius : boxes.radius[i]));
+
+	unsigned int j = jBegin;
+	for (; j + 8 <= jEnd; j += 8)
+	{
+		const unsigned int mask = compactOverlapLanesSSE42<sharedRadius>(x1, y1, z1, r1, boxes, j);
+		if (mask && appendCompactHits<Predicate>(mask, boxes, i, j, pairs, count))
+			return count;
+	}
+
+	// the last few boxes that don't fill a register
+	for (; j < jEnd; j++)
+	{
+		if (overlapsCompact<Predicate>(boxes, i, j))
+		{
+			pairs[count++] = { i, j };
+			if (Predicate::firstHitOnly)
+				break;
+		}
+	}
+	return count;
+}
+
+template <class Predicate>
+static unsigned int findCompactOverlapsSSE42(const CompactBoxSoA& boxes, const unsigned int i, const unsigned int jBegin, const unsigned int jEnd, CollisionPair* pairs)
+{
+	if (boxes.radius)
+		return compactRowSSE42<Predicate, false>(boxes, i, jBegin, jEnd, pairs);
+	return compactRowSSE42<Predicate, true>(boxes, i, jBegin, jEnd, pairs);
+}
+
+// Four boxes at a time, with no branches - the bounces are blended in where a box is outside the world.
+// The same operations in the same order as integrateScalar.
+void integrateSSE42(const BoxArrays& boxes, const unsigned int begin, const unsigned int end, const float deltaTime)
+{
+	const __m128 gravityStep = _mm_set1_ps(gravity * deltaTime);
+	const __m128 dt = _mm_set1_ps(deltaTime);
+	const __m128 floorY = _mm_set1_ps(minY);
+	const __m128 wallMinX = _mm_set1_ps(minX);
+	const __m128 wallMaxX = _mm_set1_ps(maxX);
+	const __m128 wallMinZ = _mm_set1_ps(minZ);
+	const __m128 wallMaxZ = _mm_set1_ps(maxZ);
+	const __m128 floorBounce = _mm_set1_ps(-0.7f); // the floor takes 30% of the energy
+	const __m128 signBit = _mm_set1_ps(-0.0f);
+
+	unsigned int i = begin;
+	for (; i + 4 <= end; i += 4)
+	{
+		const __m128 radius = _mm_loadu_ps(boxes.radius + i);
+		__m128 vx = _mm_loadu_ps(boxes.vx + i);
+		__m128 vy = _mm_add_ps(_mm_loadu_ps(boxes.vy + i), gravityStep);
+		__m128 vz = _mm_loadu_ps(boxes.vz + i);
+		const __m128 x = _mm_add_ps(_mm_loadu_ps(boxes.x + i), _mm_mul_ps(vx, dt));
+		__m128 y = _mm_add_ps(_mm_loadu_ps(boxes.y + i), _mm_mul_ps(vy, dt));
+		const __m128 z = _mm_add_ps(_mm_loadu_ps(boxes.z + i), _mm_mul_ps(vz, dt));
+
+		// sitting on the floor
+		const __m128 onFloor = _mm_cmplt_ps(_mm_sub_ps(y, radius), floorY);
+		y = _mm_blendv_ps(y, _mm_add_ps(floorY, radius), onFloor);
+		vy = _mm_blendv_ps(vy, _mm_mul_ps(vy, floorBounce), onFloor);
+
+		// a wall flips the sign of the velocity into it
+		const __m128 wallX = _mm_or_ps(_mm_cmplt_ps(_mm_sub_ps(x, radius), wallMinX), _mm_cmpgt_ps(_mm_add_ps(x, radius), wallMaxX));
+		const __m128 wallZ = _mm_or_ps(_mm_cmplt_ps(_mm_sub_ps(z, radius), wallMinZ), _mm_cmpgt_ps(_mm_add_ps(z, radius), wallMaxZ));
+		vx = _mm_xor_ps(vx, _mm_and_ps(wallX, signBit));
+		vz = _mm_xor_ps(vz, _mm_and_ps(wallZ, signBit));
+
+		_mm_storeu_ps(boxes.x + i, x);
+		_mm_storeu_ps(boxes.y + i, y);
+		_mm_storeu_ps(boxes.z + i, z);
+		_mm_storeu_ps(boxes.vx + i, vx);
+		_mm_storeu_ps(boxes.vy + i, vy);
+		_mm_storeu_ps(boxes.vz + i, vz);
+	}
+
+	if (i < end)
+		scalarCollisionKernels.integrate(boxes, i, end, deltaTime);
+}
+
+const CollisionKernels sse42CollisionKernels = {
+	"SSE4.2",
+	resolveCollisionsScalar,
+	nullptr,
+	{ findOverlapsSSE42<AABBPredicate>, findOverlapsSSE42<SpherePredicate>, findOverlapsSSE42<FirstHitPredicate> },
+	{ findCompactOverlapsSSE42<AABBPredicate>, findCompactOverlapsSSE42<SpherePredicate>, findCompactOverlapsSSE42<FirstHitPredicate> },
+	integrateSSE42
+};
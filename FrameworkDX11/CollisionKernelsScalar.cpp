@@ -0,0 +1,138 @@
+// Plain C++ versions of the kernels - the reference the SIMD versions are checked against
+
+#include "CollisionKernels.h"
+#include <cmath>
+
+static void resolveCollisionScalar(const BoxArrays& boxes, const unsigned int a, const unsigned int b)
+{
+	XMFLOAT3 normal = { boxes.x[a] - boxes.x[b], boxes.y[a] - boxes.y[b], boxes.z[a] - boxes.z[b] };
+
+	float length = std::sqrt(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+	// Normalize the normal vector
+	if (length > 0)
+	{
+		normal.x /= length;
+		normal.y /= length;
+		normal.z /= length;
+	}
+
+	float relativeVelocityX = boxes.vx[a] - boxes.vx[b];
+	float relativeVelocityY = boxes.vy[a] - boxes.vy[b];
+	float relativeVelocityZ = boxes.vz[a] - boxes.vz[b];
+
+	// Compute the relative velocity along the normal
+	float impulse = relativeVelocityX * normal.x + relativeVelocityY * normal.y + relativeVelocityZ * normal.z;
+
+	// Ignore collision if objects are moving away from each other
+	if (impulse > 0) {
+		return;
+	}
+
+	// Compute the collision impulse scalar
+	float e = 0.01f; // Coefficient of restitution (0 = inelastic, 1 = elastic)
+	float dampening = 0.9f; // Dampening factor (0.9 = 10% energy reduction)
+	float j = -(1.0f + e) * impulse * dampening;
+
+	// Apply the impulse to the boxes' velocities
+	boxes.vx[a] += j * normal.x;
+	boxes.vy[a] += j * normal.y;
+	boxes.vz[a] += j * normal.z;
+	boxes.vx[b] -= j * normal.x;
+	boxes.vy[b] -= j * normal.y;
+	boxes.vz[b] -= j * normal.z;
+}
+
+void resolveCollisionsScalar(const BoxArrays& boxes, const CollisionPair* pairs, const unsigned int count)
+{
+	for (unsigned int k = 0; k < count; k++)
+		resolveCollisionScalar(boxes, pairs[k].index1, pairs[k].index2);
+}
+
+template <class Predicate, bool sharedRadius>
+static unsigned int rowScalar(const BoxSoA& boxes, const unsigned int i, const unsigned int jBegin, const unsigned int jEnd, CollisionPair* pairs)
+{
+	unsigned int count = 0;
+	const float xi = boxes.x[i];
+	const float yi = boxes.y[i];
+	const float zi = boxes.z[i];
+	const float ri = sharedRadius ? boxes.sharedRadius : boxes.radius[i];
+
+	for (unsigned int j = jBegin; j < jEnd; j++)
+	{
+		// with a shared radius, the sum of the radii (and its square) is the same for every j, so it's lifted out of the loop
+		const float rj = sharedRadius ? ri : boxes.radius[j];
+		if (Predicate::overlaps(xi, yi, zi, ri, boxes.x[j], boxes.y[j], boxes.z[j], rj))
+		{
+			pairs[count++] = { i, j };
+			if (Predicate::firstHitOnly)
+				break;
+		}
+	}
+	return count;
+}
+
+template <class Predicate>
+static unsigned int findOverlapsScalar(const BoxSoA& boxes, const unsigned int i, const unsigned int jBegin, const unsigned int jEnd, CollisionPair* pairs)
+{
+	if (boxes.radius)
+		return rowScalar<Predicate, false>(boxes, i, jBegin, jEnd, pairs);
+	return rowScalar<Predicate, true>(boxes, i, jBegin, jEnd, pairs);
+}
+
+template <class Predicate>
+static unsigned int findCompactOverlapsScalar(const CompactBoxSoA& boxes, const unsigned int i, const unsigned int jBegin, const unsigned int jEnd, CollisionPair* pairs)
+{
+	unsigned int count = 0;
+	for (unsigned int j = jBegin; j < jEnd; j++)
+	{
+		if (overlapsCompact<Predicate>(boxes, i, j))
+		{
+			pairs[count++] = { i, j };
+			if (Predicate::firstHitOnly)
+				break;
+		}
+	}
+	return count;
+}
+
+static void integrateScalar(const BoxArrays& boxes, const unsigned int begin, const unsigned int end, const float deltaTime)
+{
+	const float floorY = minY;
+
+	for (unsigned int i = begin; i < end; i++) {
+
+		const float radius = boxes.radius[i];
+
+		// Update velocity due to gravity
+		boxes.vy[i] += gravity * deltaTime;
+
+		// Update position based on velocity
+		boxes.x[i] += boxes.vx[i] * deltaTime;
+		boxes.y[i] += boxes.vy[i] * deltaTime;
+		boxes.z[i] += boxes.vz[i] * deltaTime;
+
+		// Check for collision with the floor
+		if (boxes.y[i] - radius < floorY) {
+			boxes.y[i] = floorY + radius;
+			float dampening = 0.7f;
+			boxes.vy[i] = -boxes.vy[i] * dampening;
+		}
+
+		// Check for collision with the walls
+		if (boxes.x[i] - radius < minX || boxes.x[i] + radius > maxX) {
+			boxes.vx[i] = -boxes.vx[i];
+		}
+		if (boxes.z[i] - radius < minZ || boxes.z[i] + radius > maxZ) {
+			boxes.vz[i] = -boxes.vz[i];
+		}
+	}
+}
+
+const CollisionKernels scalarCollisionKernels = {
+	"scalar",
+	resolveCollisionsScalar,
+	nullptr,
+	{ findOverlapsScalar<AABBPredicate>, findOverlapsScalar<SpherePredicate>, findOverlapsScalar<FirstHitPredicate> },
+	{ findCompactOverlapsScalar<AABBPredicate>, findCompactOverlapsScalar<SpherePredicate>, findCompactOverlapsScalar<FirstHitPredicate> },
+	integrateScalar
+};
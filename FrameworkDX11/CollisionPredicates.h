@@ -0,0 +1,84 @@
+// MIT License
+// Copyright (c) 2025 David White
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+
+// The collision tests as policy types
+// The kernels are templates on these, so every method can use any test with no cost inside the loops - and the
+// methods can be compared like for like. The SIMD kernels build the same test as overlaps() from sphereTest,
+// as does overlapsCompact for the quantized boxes (CollisionKernels.h).
+
+#pragma once
+
+#include <cmath>
+#include "BoxStore.h"
+#include "constants.h"
+
+// The x, y and z extents (radius either side of the centre) overlap - ColliderManager::checkCollision
+struct AABBPredicate
+{
+    static constexpr int id = predicate_aabb;
+    static constexpr bool sphereTest = false;
+    static constexpr bool firstHitOnly = false;
+
+    static bool overlaps(const float x1, const float y1, const float z1, const float r1, const float x2, const float y2, const float z2, const float r2)
+    {
+        const float sumRadii = r1 + r2;
+        return std::abs(x1 - x2) < sumRadii && std::abs(y1 - y2) < sumRadii && std::abs(z1 - z2) < sumRadii;
+    }
+};
+
+// The centres are closer than the sum of the radii
+struct SpherePredicate
+{
+    static constexpr int id = predicate_sphere;
+    static constexpr bool sphereTest = true;
+    static constexpr bool firstHitOnly = false;
+
+    static bool overlaps(const float x1, const float y1, const float z1, const float r1, const float x2, const float y2, const float z2, const float r2)
+    {
+        const float dx = x1 - x2;
+        const float dy = y1 - y2;
+        const float dz = z1 - z2;
+        const float sumRadii = r1 + r2;
+        return dx * dx + dy * dy + dz * dz < sumRadii * sumRadii;
+    }
+};
+
+// The sphere test, but each box only collides with the first later box it hits
+struct FirstHitPredicate : SpherePredicate
+{
+    static constexpr int id = predicate_first_hit;
+    static constexpr bool firstHitOnly = true;
+};
+
+template <class Predicate>
+inline bool overlaps(const BoxStore& boxes, const unsigned int i, const unsigned int j)
+{
+    return Predicate::overlaps(boxes.x()[i], boxes.y()[i], boxes.z()[i], boxes.radius()[i],
+        boxes.x()[j], boxes.y()[j], boxes.z()[j], boxes.radius()[j]);
+}
+
+inline const char* predicateName(const int predicate)
+{
+    switch (predicate)
+    {
+    case predicate_aabb:
+        return "AABB";
+    case predicate_sphere:
+        return "sphere";
+    case predicate_first_hit:
+        return "first hit sphere";
+    default:
+        return "per method";
+    }
+}
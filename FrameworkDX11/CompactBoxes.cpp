@@ -0,0 +1,48 @@
+#include "CompactBoxes.h"
+#include <cmath>
+
+uint16_t CompactBoxes::quantize(const float value, const float worldMin)
+{
+	const float steps = std::round((value - worldMin) / compact_step);
+	return (uint16_t)std::min(std::max(steps, 0.0f), 65535.0f);
+}
+
+uint16_t CompactBoxes::quantizeRadius(const float radius)
+{
+	const float steps = std::round(radius / compact_step);
+	return (uint16_t)std::min(std::max(steps, 0.0f), (float)compact_max_radius);
+}
+
+void CompactBoxes::pack(const BoxStore& boxes)
+{
+	const unsigned int numBoxes = (unsigned int)boxes.size();
+	m_x.resize(numBoxes);
+	m_y.resize(numBoxes);
+	m_z.resize(numBoxes);
+
+	bool sharedRadius = true;
+	for (unsigned int i = 0; i < numBoxes; i++)
+	{
+		const XMFLOAT4 p = boxes.positionAndRadius(i);
+		m_x[i] = quantize(p.x, minX);
+		m_y[i] = quantize(p.y, minY);
+		m_z[i] = quantize(p.z, minZ);
+		sharedRadius = sharedRadius && p.w == boxes.radius()[0];
+	}
+
+	uint16_t radius = 0;
+	if (sharedRadius)
+	{
+		m_radius.clear();
+		if (numBoxes > 0)
+			radius = quantizeRadius(boxes.radius()[0]);
+	}
+	else
+	{
+		m_radius.resize(numBoxes);
+		for (unsigned int i = 0; i < numBoxes; i++)
+			m_radius[i] = quantizeRadius(boxes.radius()[i]);
+	}
+
+	m_view = { m_x.data(), m_y.data(), m_z.data(), sharedRadius ? nullptr : m_radius.data(), radius, numBoxes };
+}
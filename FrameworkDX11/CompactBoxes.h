@@ -0,0 +1,65 @@
+// MIT License
+// Copyright (c) 2025 David White
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+
+// A compact, quantized copy of the boxes for the all pairs loops on large scenes
+// Those loops stream every later box through the cache for each box, so with enough boxes they are limited by memory
+// bandwidth, not by the compares. Here each position is 16 bit fixed point inside the fixed world bounds and, when
+// every box is the same size, the radius is stored once - 6 bytes a box rather than the 16 of a float x, y, z and
+// radius (or 8 bytes with mixed sizes), and the compact row kernels compare them as 16 bit integers.
+// A step is just under a thousandth of a unit, so a pair within a step or so of touching can come out either way.
+// The simulation itself stays in full precision - a slow box moves less than a step in a frame, so quantized positions
+// would never move, and the loops never read the velocities.
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include "Box.h"
+#include "BoxStore.h"
+#include "AlignedAllocator.h"
+#include "CollisionKernels.h"
+
+using namespace std;
+
+// One step size for every axis, so a distance along any axis and a radius are the same number of steps and can be
+// compared directly. The longest side of the world fills the 16 bits.
+constexpr float compact_world_size = std::max({ maxX - minX, maxY - minY, maxZ - minZ });
+constexpr float compact_step = compact_world_size / 65535.0f;
+// no radius is anywhere near this, and it keeps the sum of two radii inside 16 bits
+constexpr unsigned int compact_max_radius = 0x7fff;
+
+class CompactBoxes
+{
+public:
+    CompactBoxes() = default;
+
+    // quantize the positions and radii of boxes - positions outside the world bounds are clamped to them
+    void pack(const BoxStore& boxes);
+
+    const CompactBoxSoA& view() const { return m_view; }
+    bool hasSharedRadius() const { return m_view.radius == nullptr; }
+    unsigned int bytesPerBox() const { return hasSharedRadius() ? 3 * sizeof(uint16_t) : 4 * sizeof(uint16_t); }
+
+    static uint16_t quantize(const float value, const float worldMin);
+    static float dequantize(const uint16_t value, const float worldMin) { return worldMin + value * compact_step; }
+    static uint16_t quantizeRadius(const float radius);
+
+private:
+    AlignedVector<uint16_t> m_x;
+    AlignedVector<uint16_t> m_y;
+    AlignedVector<uint16_t> m_z;
+    AlignedVector<uint16_t> m_radius; // empty when the radius is shared
+    CompactBoxSoA           m_view = {};
+};
@@ -324,7 +324,7 @@ void DX11Renderer::cleanupDevice()
 //
 // With VS 11, we could load up prebuilt .cso files instead...
 //--------------------------------------------------------------------------------------
-HRESULT DX11Renderer::compileShaderFromFile(const WCHAR* szFileName, LPCSTR szEntryPoint, LPCSTR szShaderModel, ID3DBlob** ppBlobOut)
+HRESULT DX11Renderer::compileShaderFromFile(const WCHAR* szFileName, LPCSTR szEntryPoint, LPCSTR szShaderModel, ID3DBlob** ppBlobOut, const D3D_SHADER_MACRO* pDefines)
 {
     HRESULT hr = S_OK;
 
@@ -341,7 +341,7 @@ HRESULT DX11Renderer::compileShaderFromFile(const WCHAR* szFileName, LPCSTR szEn
 #endif
 
     ID3DBlob* pErrorBlob = nullptr;
-    hr = D3DCompileFromFile(szFileName, nullptr, nullptr, szEntryPoint, szShaderModel,
+    hr = D3DCompileFromFile(szFileName, pDefines, nullptr, szEntryPoint, szShaderModel,
         dwShaderFlags, 0, ppBlobOut, &pErrorBlob);
     if (FAILED(hr))
     {
@@ -487,15 +487,52 @@ void DX11Renderer::startIMGUIDraw(const unsigned int FPS)
     ImGui::SetWindowFontScale(4.0f);
     ImGui::Text("FPS %d", FPS);
     ImGui::SetWindowFontScale(1.0f);
+    ImGui::Text("%s test, %u pairs%s", g_collision_stats.predicate, g_collision_stats.pairCount,
+        g_collision_stats.uniformRadius ? ", one radius kernels" : "");
     ImGui::Spacing();
 
     if (ImGui::RadioButton("Single threaded CPU", g_ttype == use_cpu_singlethread)) g_ttype = use_cpu_singlethread;
     if (ImGui::RadioButton("Multi threaded CPU", g_ttype == use_cpu_multithread)) g_ttype = use_cpu_multithread;
     if (ImGui::RadioButton("GPU", g_ttype == use_gpu)) g_ttype = use_gpu;
+    if (ImGui::RadioButton("GPU compute shader emulated on the CPU", g_ttype == use_gpu_emulated)) g_ttype = use_gpu_emulated;
+    ImGui::Checkbox("Cache blocked (tiled) CPU loops", &g_tiled_all_pairs);
+    ImGui::SliderInt("Multi threaded chunks per thread", &g_all_pairs_chunks_per_thread, 1, 64);
+    if (ImGui::RadioButton("Thread pool queue with a lock", g_task_queue == task_queue_locked)) g_task_queue = task_queue_locked;
+    ImGui::SameLine();
+    if (ImGui::RadioButton("Lock free", g_task_queue == task_queue_lock_free)) g_task_queue = task_queue_lock_free;
+    ImGui::Checkbox("Workers spin before they sleep", &g_adaptive_spin);
+    ImGui::Checkbox("SIMD kernels", &g_simd_kernels);
+    ImGui::SameLine();
+    ImGui::Text("(%s)", g_simd_kernels_name);
+    ImGui::Checkbox("Compact 16 bit boxes in the CPU loops", &g_compact_boxes);
+    ImGui::Checkbox("Batched SIMD collision resolve", &g_batched_resolve);
+    ImGui::SameLine();
+    ImGui::Checkbox("Bit exact", &g_exact_resolve);
+    ImGui::Checkbox("Multi threaded movement update", &g_parallel_movement);
+    if (ImGui::RadioButton("Spatial hash grid CPU", g_ttype == use_cpu_grid)) g_ttype = use_cpu_grid;
+    if (ImGui::RadioButton("Sweep and prune CPU", g_ttype == use_cpu_sap)) g_ttype = use_cpu_sap;
+    if (ImGui::RadioButton("Dynamic AABB tree CPU", g_ttype == use_cpu_aabb_tree)) g_ttype = use_cpu_aabb_tree;
+    if (ImGui::RadioButton("Linear BVH multi threaded CPU", g_ttype == use_cpu_lbvh)) g_ttype = use_cpu_lbvh;
+    if (ImGui::RadioButton("Cell list multi threaded CPU", g_ttype == use_cpu_cell_list)) g_ttype = use_cpu_cell_list;
+    if (ImGui::RadioButton("Verlet neighbour list multi threaded CPU", g_ttype == use_cpu_neighbour_list)) g_ttype = use_cpu_neighbour_list;
+    if (ImGui::RadioButton("Hierarchical grid CPU", g_ttype == use_cpu_hierarchical_grid)) g_ttype = use_cpu_hierarchical_grid;
 
     ImGui::Spacing();
 
     ImGui::SliderInt("Number of Cubes", &g_cube_count, 2, max_number_of_boxes);
+    ImGui::Checkbox("Mixed cube sizes", &g_mixed_box_sizes);
+    ImGui::SliderInt("Sort cubes along a curve every N frames (0 = never)", &g_reorder_interval, 0, 600);
+    if (ImGui::RadioButton("Morton curve", g_reorder_curve == curve_morton)) g_reorder_curve = curve_morton;
+    ImGui::SameLine();
+    if (ImGui::RadioButton("Hilbert curve", g_reorder_curve == curve_hilbert)) g_reorder_curve = curve_hilbert;
+
+    ImGui::Spacing();
+
+    ImGui::Text("Collision test");
+    if (ImGui::RadioButton("Each method's own", g_predicate == predicate_per_method)) g_predicate = predicate_per_method;
+    if (ImGui::RadioButton("AABB", g_predicate == predicate_aabb)) g_predicate = predicate_aabb;
+    if (ImGui::RadioButton("Sphere", g_predicate == predicate_sphere)) g_predicate = predicate_sphere;
+    if (ImGui::RadioButton("Sphere, first hit only", g_predicate == predicate_first_hit)) g_predicate = predicate_first_hit;
 
     
 }
@@ -44,7 +44,7 @@ public:
 	void	update(const float deltaTime);
 
 	// a helper method - todo: move to a unique class to reduce dependency on Renderer
-	static HRESULT compileShaderFromFile(const WCHAR* szFileName, LPCSTR szEntryPoint, LPCSTR szShaderModel, ID3DBlob** ppBlobOut);
+	static HRESULT compileShaderFromFile(const WCHAR* szFileName, LPCSTR szEntryPoint, LPCSTR szShaderModel, ID3DBlob** ppBlobOut, const D3D_SHADER_MACRO* pDefines = nullptr);
 
 	void input(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam);
 
@@ -0,0 +1,444 @@
+#include "DynamicAABBTree.h"
+#include <algorithm>
+#include <cmath>
+
+void DynamicAABBTree::update(const BoxStore& boxes)
+{
+	// boxes taken away from the end of the list
+	while (m_boxProxies.size() > boxes.size())
+	{
+		if (m_boxProxies.back() != null_node)
+			destroyProxy(m_boxProxies.back());
+		m_boxProxies.pop_back();
+	}
+
+	unsigned int reinserted = 0;
+	for (unsigned int i = 0; i < m_boxProxies.size(); i++)
+	{
+		if (m_boxProxies[i] == null_node)
+			m_boxProxies[i] = createProxy(boxAABB(boxes.positionAndRadius(i)), i);
+		else if (moveProxy(m_boxProxies[i], boxAABB(boxes.positionAndRadius(i))))
+			reinserted++;
+	}
+
+	// boxes added to the end of the list
+	for (unsigned int i = m_boxProxies.size(); i < boxes.size(); i++)
+	{
+		m_boxProxies.push_back(createProxy(boxAABB(boxes.positionAndRadius(i)), i));
+	}
+
+	m_lastReinsertCount = reinserted;
+}
+
+void DynamicAABBTree::remapBoxes(const vector<unsigned int>& newIndex)
+{
+	unsigned int newCount = 0;
+	for (const unsigned int boxIndex : newIndex)
+	{
+		if (boxIndex != removed_box)
+			newCount = std::max(newCount, boxIndex + 1);
+	}
+
+	// boxes the tree hasn't seen yet (if it hasn't run since they were added) get their leaves in the next update
+	m_remappedProxies.assign(newCount, null_node);
+	for (unsigned int i = 0; i < m_boxProxies.size(); i++)
+	{
+		const int proxyId = m_boxProxies[i];
+		if (proxyId == null_node)
+			continue;
+
+		if (i >= newIndex.size() || newIndex[i] == removed_box)
+		{
+			destroyProxy(proxyId);
+			continue;
+		}
+
+		m_nodes[proxyId].boxIndex = newIndex[i];
+		m_remappedProxies[newIndex[i]] = proxyId;
+	}
+	m_boxProxies.swap(m_remappedProxies);
+}
+
+void DynamicAABBTree::findPairs(const BoxStore& boxes, vector<CollisionPair>& results)
+{
+	if (m_root == null_node)
+		return;
+
+	for (unsigned int i = 0; i < boxes.size(); i++)
+	{
+		const XMFLOAT4 a = boxes.positionAndRadius(i);
+		const AABB queryAABB = boxAABB(a);
+
+		m_stack.clear();
+		m_stack.push_back(m_root);
+
+		while (!m_stack.empty())
+		{
+			const TreeNode& node = m_nodes[m_stack.back()];
+			m_stack.pop_back();
+
+			if (!overlaps(node.aabb, queryAABB))
+				continue;
+
+			if (!node.isLeaf())
+			{
+				m_stack.push_back(node.child1);
+				m_stack.push_back(node.child2);
+				continue;
+			}
+
+			// the leaf's fat bounds overlap, so do the real check - only against later boxes to avoid double checks
+			const unsigned int j = node.boxIndex;
+			if (j <= i)
+				continue;
+
+			const XMFLOAT4 b = boxes.positionAndRadius(j);
+			const float sumRadii = a.w + b.w;
+			if (std::abs(a.x - b.x) < sumRadii && std::abs(a.y - b.y) < sumRadii && std::abs(a.z - b.z) < sumRadii)
+				results.push_back({ i, j });
+		}
+	}
+}
+
+int DynamicAABBTree::createProxy(const AABB& tightAABB, const unsigned int boxIndex)
+{
+	const int proxyId = allocateNode();
+	TreeNode& node = m_nodes[proxyId];
+	node.aabb = fatten(tightAABB, (tightAABB.upper.x - tightAABB.lower.x) * 0.5f * fat_margin_scale);
+	node.boxIndex = boxIndex;
+	node.height = 0;
+
+	insertLeaf(proxyId);
+	return proxyId;
+}
+
+void DynamicAABBTree::destroyProxy(const int proxyId)
+{
+	removeLeaf(proxyId);
+	freeNode(proxyId);
+}
+
+// returns true if the leaf had to be re-inserted
+bool DynamicAABBTree::moveProxy(const int proxyId, const AABB& tightAABB)
+{
+	if (contains(m_nodes[proxyId].aabb, tightAABB))
+		return false;
+
+	removeLeaf(proxyId);
+	m_nodes[proxyId].aabb = fatten(tightAABB, (tightAABB.upper.x - tightAABB.lower.x) * 0.5f * fat_margin_scale);
+	insertLeaf(proxyId);
+	return true;
+}
+
+int DynamicAABBTree::allocateNode()
+{
+	if (m_freeList == null_node)
+	{
+		// grow the pool and thread the new nodes on to the free list
+		const int oldCapacity = m_nodes.size();
+		const int newCapacity = std::max(16, oldCapacity * 2);
+		m_nodes.resize(newCapacity);
+		for (int i = oldCapacity; i < newCapacity; i++)
+		{
+			m_nodes[i].parent = (i + 1 < newCapacity) ? i + 1 : null_node;
+			m_nodes[i].height = -1;
+		}
+		m_freeList = oldCapacity;
+	}
+
+	const int nodeId = m_freeList;
+	TreeNode& node = m_nodes[nodeId];
+	m_freeList = node.parent;
+
+	node.parent = null_node;
+	node.child1 = null_node;
+	node.child2 = null_node;
+	node.height = 0;
+	node.boxIndex = -1;
+	return nodeId;
+}
+
+void DynamicAABBTree::freeNode(const int nodeId)
+{
+	m_nodes[nodeId].parent = m_freeList;
+	m_nodes[nodeId].height = -1;
+	m_freeList = nodeId;
+}
+
+void DynamicAABBTree::insertLeaf(const int leaf)
+{
+	if (m_root == null_node)
+	{
+		m_root = leaf;
+		m_nodes[leaf].parent = null_node;
+		return;
+	}
+
+	// find the best sibling - walk down, at each level taking the child whose bounds grow least,
+	// and stop when it's cheaper to pair up with the current node than to descend further
+	const AABB leafAABB = m_nodes[leaf].aabb;
+	int index = m_root;
+	while (!m_nodes[index].isLeaf())
+	{
+		const TreeNode& node = m_nodes[index];
+		const float area = surfaceArea(node.aabb);
+		const float combinedArea = surfaceArea(combine(node.aabb, leafAABB));
+
+		// cost of creating a new parent for this node and the leaf
+		const float cost = 2.0f * combinedArea;
+		// minimum cost of pushing the leaf further down the tree
+		const float inheritanceCost = 2.0f * (combinedArea - area);
+
+		float childCost[2];
+		const int children[2] = { node.child1, node.child2 };
+		for (int c = 0; c < 2; c++)
+		{
+			const TreeNode& child = m_nodes[children[c]];
+			const float grownArea = surfaceArea(combine(leafAABB, child.aabb));
+			childCost[c] = child.isLeaf() ? grownArea + inheritanceCost : (grownArea - surfaceArea(child.aabb)) + inheritanceCost;
+		}
+
+		if (cost < childCost[0] && cost < childCost[1])
+			break;
+
+		index = (childCost[0] < childCost[1]) ? children[0] : children[1];
+	}
+
+	const int sibling = index;
+
+	// create a new parent for the sibling and the leaf
+	const int oldParent = m_nodes[sibling].parent;
+	const int newParent = allocateNode();
+	m_nodes[newParent].parent = oldParent;
+	m_nodes[newParent].aabb = combine(leafAABB, m_nodes[sibling].aabb);
+	m_nodes[newParent].height = m_nodes[sibling].height + 1;
+	m_nodes[newParent].child1 = sibling;
+	m_nodes[newParent].child2 = leaf;
+	m_nodes[sibling].parent = newParent;
+	m_nodes[leaf].parent = newParent;
+
+	if (oldParent != null_node)
+	{
+		if (m_nodes[oldParent].child1 == sibling)
+			m_nodes[oldParent].child1 = newParent;
+		else
+			m_nodes[oldParent].child2 = newParent;
+	}
+	else
+	{
+		m_root = newParent;
+	}
+
+	fixUpwardsFrom(m_nodes[leaf].parent);
+}
+
+void DynamicAABBTree::removeLeaf(const int leaf)
+{
+	if (leaf == m_root)
+	{
+		m_root = null_node;
+		return;
+	}
+
+	const int parent = m_nodes[leaf].parent;
+	const int grandParent = m_nodes[parent].parent;
+	const int sibling = (m_nodes[parent].child1 == leaf) ? m_nodes[parent].child2 : m_nodes[parent].child1;
+
+	if (grandParent != null_node)
+	{
+		// the sibling takes the parent's place
+		if (m_nodes[grandParent].child1 == parent)
+			m_nodes[grandParent].child1 = sibling;
+		else
+			m_nodes[grandParent].child2 = sibling;
+		m_nodes[sibling].parent = grandParent;
+		freeNode(parent);
+
+		fixUpwardsFrom(grandParent);
+	}
+	else
+	{
+		m_root = sibling;
+		m_nodes[sibling].parent = null_node;
+		freeNode(parent);
+	}
+}
+
+// walk back up to the root, rebalancing and refitting the bounds and heights
+void DynamicAABBTree::fixUpwardsFrom(int index)
+{
+	while (index != null_node)
+	{
+		index = balance(index);
+
+		TreeNode& node = m_nodes[index];
+		const TreeNode& child1 = m_nodes[node.child1];
+		const TreeNode& child2 = m_nodes[node.child2];
+		node.height = 1 + std::max(child1.height, child2.height);
+		node.aabb = combine(child1.aabb, child2.aabb);
+
+		index = node.parent;
+	}
+}
+
+// Perform a left or right rotation if node A is imbalanced, returns the new root of this sub-tree
+// A has children B and C. If C is more than one level taller than B, C is rotated up to take A's place
+// (and A takes one of C's children, F or G), and the same the other way round with B's children D and E.
+int DynamicAABBTree::balance(const int iA)
+{
+	TreeNode& A = m_nodes[iA];
+	if (A.isLeaf() || A.height < 2)
+		return iA;
+
+	const int iB = A.child1;
+	const int iC = A.child2;
+	TreeNode& B = m_nodes[iB];
+	TreeNode& C = m_nodes[iC];
+
+	const int imbalance = C.height - B.height;
+
+	// rotate C up
+	if (imbalance > 1)
+	{
+		const int iF = C.child1;
+		const int iG = C.child2;
+		TreeNode& F = m_nodes[iF];
+		TreeNode& G = m_nodes[iG];
+
+		// swap A and C
+		C.child1 = iA;
+		C.parent = A.parent;
+		A.parent = iC;
+
+		// A's old parent should point to C
+		if (C.parent != null_node)
+		{
+			if (m_nodes[C.parent].child1 == iA)
+				m_nodes[C.parent].child1 = iC;
+			else
+				m_nodes[C.parent].child2 = iC;
+		}
+		else
+		{
+			m_root = iC;
+		}
+
+		// the taller of F and G stays with C, the other moves across to A
+		if (F.height > G.height)
+		{
+			C.child2 = iF;
+			A.child2 = iG;
+			G.parent = iA;
+			A.aabb = combine(B.aabb, G.aabb);
+			C.aabb = combine(A.aabb, F.aabb);
+			A.height = 1 + std::max(B.height, G.height);
+			C.height = 1 + std::max(A.height, F.height);
+		}
+		else
+		{
+			C.child2 = iG;
+			A.child2 = iF;
+			F.parent = iA;
+			A.aabb = combine(B.aabb, F.aabb);
+			C.aabb = combine(A.aabb, G.aabb);
+			A.height = 1 + std::max(B.height, F.height);
+			C.height = 1 + std::max(A.height, G.height);
+		}
+
+		return iC;
+	}
+
+	// rotate B up
+	if (imbalance < -1)
+	{
+		const int iD = B.child1;
+		const int iE = B.child2;
+		TreeNode& D = m_nodes[iD];
+		TreeNode& E = m_nodes[iE];
+
+		// swap A and B
+		B.child1 = iA;
+		B.parent = A.parent;
+		A.parent = iB;
+
+		// A's old parent should point to B
+		if (B.parent != null_node)
+		{
+			if (m_nodes[B.parent].child1 == iA)
+				m_nodes[B.parent].child1 = iB;
+			else
+				m_nodes[B.parent].child2 = iB;
+		}
+		else
+		{
+			m_root = iB;
+		}
+
+		// the taller of D and E stays with B, the other moves across to A
+		if (D.height > E.height)
+		{
+			B.child2 = iD;
+			A.child1 = iE;
+			E.parent = iA;
+			A.aabb = combine(C.aabb, E.aabb);
+			B.aabb = combine(A.aabb, D.aabb);
+			A.height = 1 + std::max(C.height, E.height);
+			B.height = 1 + std::max(A.height, D.height);
+		}
+		else
+		{
+			B.child2 = iE;
+			A.child1 = iD;
+			D.parent = iA;
+			A.aabb = combine(C.aabb, D.aabb);
+			B.aabb = combine(A.aabb, E.aabb);
+			A.height = 1 + std::max(C.height, D.height);
+			B.height = 1 + std::max(A.height, E.height);
+		}
+
+		return iB;
+	}
+
+	return iA;
+}
+
+DynamicAABBTree::AABB DynamicAABBTree::boxAABB(const XMFLOAT4& positionAndRadius)
+{
+	const XMFLOAT4& p = positionAndRadius;
+	return { { p.x - p.w, p.y - p.w, p.z - p.w }, { p.x + p.w, p.y + p.w, p.z + p.w } };
+}
+
+DynamicAABBTree::AABB DynamicAABBTree::fatten(const AABB& aabb, const float margin)
+{
+	return {
+		{ aabb.lower.x - margin, aabb.lower.y - margin, aabb.lower.z - margin },
+		{ aabb.upper.x + margin, aabb.upper.y + margin, aabb.upper.z + margin } };
+}
+
+DynamicAABBTree::AABB DynamicAABBTree::combine(const AABB& a, const AABB& b)
+{
+	return {
+		{ std::min(a.lower.x, b.lower.x), std::min(a.lower.y, b.lower.y), std::min(a.lower.z, b.lower.z) },
+		{ std::max(a.upper.x, b.upper.x), std::max(a.upper.y, b.upper.y), std::max(a.upper.z, b.upper.z) } };
+}
+
+float DynamicAABBTree::surfaceArea(const AABB& aabb)
+{
+	const float dx = aabb.upper.x - aabb.lower.x;
+	const float dy = aabb.upper.y - aabb.lower.y;
+	const float dz = aabb.upper.z - aabb.lower.z;
+	return 2.0f * (dx * dy + dy * dz + dz * dx);
+}
+
+bool DynamicAABBTree::contains(const AABB& outer, const AABB& inner)
+{
+	return outer.lower.x <= inner.lower.x && outer.lower.y <= inner.lower.y && outer.lower.z <= inner.lower.z &&
+		inner.upper.x <= outer.upper.x && inner.upper.y <= outer.upper.y && inner.upper.z <= outer.upper.z;
+}
+
+bool DynamicAABBTree::overlaps(const AABB& a, const AABB& b)
+{
+	return a.lower.x <= b.upper.x && b.lower.x <= a.upper.x &&
+		a.lower.y <= b.upper.y && b.lower.y <= a.upper.y &&
+		a.lower.z <= b.upper.z && b.lower.z <= a.upper.z;
+}
@@ -0,0 +1,96 @@
+// MIT License
+// Copyright (c) 2025 David White
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// A dynamic AABB tree broadphase, in the style of Box2D's b2DynamicTree / Bullet's dbvt
+// Each box is a leaf holding a 'fat' AABB - its bounds grown by a margin - so while a box stays inside its fat
+// bounds the tree doesn't change at all. Only when it escapes is the leaf removed and re-inserted (and the
+// parents on the way up refit). Insertion picks the sibling using a surface area cost, and AVL style rotations
+// keep the tree balanced so queries stay logarithmic. Because the leaves are sized per box, this copes with
+// boxes of very different sizes (positionAndRadius.w) far better than a grid.
+
+#pragma once
+
+#include <vector>
+#include "Box.h"
+#include "BoxStore.h"
+
+using namespace std;
+
+class DynamicAABBTree
+{
+public:
+    DynamicAABBTree() = default;
+
+    // create / move / destroy the leaves so they match the boxes, call once per frame after the boxes have moved
+    void update(const BoxStore& boxes);
+
+    // appends every pair of boxes whose AABBs overlap (the same test as ColliderManager::checkCollision)
+    // index1 is always less than index2
+    void findPairs(const BoxStore& boxes, vector<CollisionPair>& results);
+
+    // the boxes have been reordered - box i is now at newIndex[i] (or removed_box). The leaves stay where they are
+    // in the tree and only change which box they belong to.
+    void remapBoxes(const vector<unsigned int>& newIndex);
+
+    int getHeight() const { return m_root == null_node ? 0 : m_nodes[m_root].height; }
+    // the number of leaves that escaped their fat bounds and were re-inserted in the last update
+    unsigned int getLastReinsertCount() const { return m_lastReinsertCount; }
+
+private:
+    static constexpr int null_node = -1;
+    static constexpr float fat_margin_scale = 0.5f; // fat bounds grow by half the box radius on each side
+
+    struct AABB {
+        XMFLOAT3 lower;
+        XMFLOAT3 upper;
+    };
+
+    struct TreeNode {
+        AABB    aabb;
+        int     parent; // when the node is free, this is the next free node instead
+        int     child1;
+        int     child2;
+        int     height; // 0 for a leaf, -1 when free
+        int     boxIndex; // leaves only
+
+        bool isLeaf() const { return child1 == null_node; }
+    };
+
+    int     createProxy(const AABB& tightAABB, const unsigned int boxIndex);
+    void    destroyProxy(const int proxyId);
+    bool    moveProxy(const int proxyId, const AABB& tightAABB);
+
+    int     allocateNode();
+    void    freeNode(const int nodeId);
+    void    insertLeaf(const int leaf);
+    void    removeLeaf(const int leaf);
+    int     balance(const int iA);
+    void    fixUpwardsFrom(int index);
+
+    static AABB     boxAABB(const XMFLOAT4& positionAndRadius);
+    static AABB     fatten(const AABB& aabb, const float margin);
+    static AABB     combine(const AABB& a, const AABB& b);
+    static float    surfaceArea(const AABB& aabb);
+    static bool     contains(const AABB& outer, const AABB& inner);
+    static bool     overlaps(const AABB& a, const AABB& b);
+
+private:
+    vector<TreeNode>    m_nodes;
+    int                 m_root = null_node;
+    int                 m_freeList = null_node;
+
+    vector<int>         m_boxProxies; // the leaf node for each box, or null_node if it doesn't have one yet
+    vector<int>         m_remappedProxies; // remapBoxes builds the new m_boxProxies in this
+    vector<int>         m_stack; // reused traversal stack for queries
+    unsigned int        m_lastReinsertCount = 0;
+};
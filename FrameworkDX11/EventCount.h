@@ -0,0 +1,80 @@
+// MIT License
+// Copyright (c) 2025 David White
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// An eventcount - lets threads sleep until "there might be something to do" without the producers taking a lock when
+// nobody is asleep. A waiter calls prepareWait, checks for work itself, then either cancelWait if it found some or wait
+// if it didn't. Anything published before a notify is seen by that check, or the notify wakes the wait.
+
+#pragma once
+
+#include <atomic>
+#include <climits>
+#include <condition_variable>
+#include <mutex>
+
+class EventCount
+{
+public:
+    using Key = unsigned int;
+
+    Key prepareWait()
+    {
+        m_waiters.fetch_add(1, std::memory_order_seq_cst);
+        return m_epoch.load(std::memory_order_seq_cst);
+    }
+
+    void cancelWait()
+    {
+        m_waiters.fetch_sub(1, std::memory_order_seq_cst);
+    }
+
+    // Sleeps until a notify after the prepareWait that gave this key
+    void wait(const Key key)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this, key] { return m_epoch.load(std::memory_order_relaxed) != key; });
+        }
+        m_waiters.fetch_sub(1, std::memory_order_seq_cst);
+    }
+
+    // Wakes up to count waiters - just an atomic load when there are none
+    void notify(const unsigned int count)
+    {
+        // the work is published before we look for waiters, as a waiter registers before it looks for work
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const unsigned int waiters = m_waiters.load(std::memory_order_relaxed);
+        if (waiters == 0 || count == 0)
+            return;
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_epoch.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (count >= waiters)
+        {
+            m_condition.notify_all();
+            return;
+        }
+        for (unsigned int i = 0; i < count; i++)
+            m_condition.notify_one();
+    }
+
+    void notifyAll() { notify(UINT_MAX); }
+
+private:
+    std::atomic<unsigned int>   m_waiters{ 0 };
+    std::atomic<Key>            m_epoch{ 0 };
+    std::mutex                  m_mutex;
+    std::condition_variable     m_condition;
+};
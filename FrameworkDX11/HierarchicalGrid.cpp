@@ -0,0 +1,118 @@
+#include "HierarchicalGrid.h"
+#include <cmath>
+#include <algorithm>
+
+void HierarchicalGrid::build(const BoxStore& boxes)
+{
+	const unsigned int numBoxes = boxes.size();
+
+	float minRadius = box_scale;
+	float maxRadius = box_scale;
+	for (unsigned int i = 0; i < numBoxes; i++)
+	{
+		minRadius = std::min(minRadius, boxes.radius()[i]);
+		maxRadius = std::max(maxRadius, boxes.radius()[i]);
+	}
+
+	// enough levels, each double the last, for the smallest level to fit the smallest box and the top one the biggest
+	m_numLevels = 1;
+	m_cellSize[0] = 2.0f * std::max(minRadius, min_cell_radius);
+	while (m_cellSize[m_numLevels - 1] < 2.0f * maxRadius && m_numLevels < max_levels)
+	{
+		m_cellSize[m_numLevels] = m_cellSize[m_numLevels - 1] * 2.0f;
+		m_numLevels++;
+	}
+	// in case the spread is too wide for max_levels, the top level has to take everything
+	m_cellSize[m_numLevels - 1] = std::max(m_cellSize[m_numLevels - 1], 2.0f * maxRadius);
+	for (unsigned int level = 0; level < m_numLevels; level++)
+		m_invCellSize[level] = 1.0f / m_cellSize[level];
+
+	unsigned int tableSize = 64;
+	while (tableSize < numBoxes * 2)
+		tableSize <<= 1;
+	m_tableMask = tableSize - 1;
+
+	m_bucketHead.assign(tableSize, -1);
+	m_next.resize(numBoxes);
+	m_boxCells.resize(numBoxes);
+	m_occupiedLevels = 0;
+
+	for (unsigned int i = 0; i < numBoxes; i++)
+	{
+		const XMFLOAT4 p = boxes.positionAndRadius(i);
+
+		// the smallest level whose cells are as wide as the box
+		int level = 0;
+		while (level < (int)m_numLevels - 1 && m_cellSize[level] < 2.0f * p.w)
+			level++;
+
+		const float inv = m_invCellSize[level];
+		const Cell cell = { (int)std::floor(p.x * inv), (int)std::floor(p.y * inv), (int)std::floor(p.z * inv), level };
+		const unsigned int bucket = hashCell(cell.x, cell.y, cell.z, level);
+
+		m_boxCells[i] = cell;
+		m_next[i] = m_bucketHead[bucket];
+		m_bucketHead[bucket] = i;
+		m_occupiedLevels |= 1u << level;
+	}
+}
+
+void HierarchicalGrid::findPairs(const BoxStore& boxes, vector<CollisionPair>& results) const
+{
+	for (unsigned int i = 0; i < boxes.size(); i++)
+	{
+		const XMFLOAT4 a = boxes.positionAndRadius(i);
+		const int homeLevel = m_boxCells[i].level;
+
+		for (int level = homeLevel; level < (int)m_numLevels; level++)
+		{
+			if (!(m_occupiedLevels & (1u << level)))
+				continue;
+
+			// any box in this level is at most half a cell in radius, so its centre must lie within
+			// this box's radius plus half a cell - that covers at most three cells along each axis
+			const float reach = a.w + 0.5f * m_cellSize[level];
+			const float inv = m_invCellSize[level];
+			const int x0 = (int)std::floor((a.x - reach) * inv), x1 = (int)std::floor((a.x + reach) * inv);
+			const int y0 = (int)std::floor((a.y - reach) * inv), y1 = (int)std::floor((a.y + reach) * inv);
+			const int z0 = (int)std::floor((a.z - reach) * inv), z1 = (int)std::floor((a.z + reach) * inv);
+
+			for (int cz = z0; cz <= z1; cz++)
+			{
+				for (int cy = y0; cy <= y1; cy++)
+				{
+					for (int cx = x0; cx <= x1; cx++)
+					{
+						for (int j = m_bucketHead[hashCell(cx, cy, cz, level)]; j != -1; j = m_next[j])
+						{
+							// skip other cells sharing the bucket
+							const Cell& other = m_boxCells[j];
+							if (other.x != cx || other.y != cy || other.z != cz || other.level != level)
+								continue;
+
+							// pairs in the same level are seen from both boxes, so only take them from the lower index
+							if (level == homeLevel && (unsigned int)j <= i)
+								continue;
+
+							const XMFLOAT4 b = boxes.positionAndRadius(j);
+							const float sumRadii = a.w + b.w;
+							if (std::abs(a.x - b.x) < sumRadii && std::abs(a.y - b.y) < sumRadii && std::abs(a.z - b.z) < sumRadii)
+							{
+								if (i < (unsigned int)j)
+									results.push_back({ i, (unsigned int)j });
+								else
+									results.push_back({ (unsigned int)j, i });
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+unsigned int HierarchicalGrid::hashCell(const int x, const int y, const int z, const int level) const
+{
+	const unsigned int hash = ((unsigned int)x * 73856093u) ^ ((unsigned int)y * 19349663u) ^ ((unsigned int)z * 83492791u) ^ ((unsigned int)level * 67867979u);
+	return hash & m_tableMask;
+}
@@ -0,0 +1,66 @@
+// MIT License
+// Copyright (c) 2025 David White
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// A hierarchical (multi level) spatial hash grid, for boxes of very different sizes
+// A single grid has to size its cells for the biggest box, so with a wide spread of sizes the small boxes end up
+// crowded many to a cell. Here every level doubles the cell size of the one below, and each box goes in the
+// smallest level whose cells are at least as wide as it is. A box then checks its own level and every level above
+// it, so each pair is found from the smaller of the two boxes and only ever looks at a few cells per level.
+// All the levels share one hash table (the level is part of the key), see Ericson, Real-Time Collision Detection 7.2.
+
+#pragma once
+
+#include <vector>
+#include "Box.h"
+#include "BoxStore.h"
+
+using namespace std;
+
+class HierarchicalGrid
+{
+public:
+    HierarchicalGrid() = default;
+
+    // re-bucket every box, call once per frame after the boxes have moved
+    void build(const BoxStore& boxes);
+
+    // appends every pair of boxes whose AABBs overlap (the same test as ColliderManager::checkCollision)
+    // index1 is always less than index2
+    void findPairs(const BoxStore& boxes, vector<CollisionPair>& results) const;
+
+    unsigned int getLevelCount() const { return m_numLevels; }
+
+private:
+    static constexpr int max_levels = 16;
+    static constexpr float min_cell_radius = box_scale / 100.0f; // a floor for level 0, so a box of radius 0 can't make its cells 0 wide
+
+    struct Cell {
+        int x;
+        int y;
+        int z;
+        int level;
+    };
+
+    unsigned int hashCell(const int x, const int y, const int z, const int level) const;
+
+private:
+    float           m_cellSize[max_levels] = {}; // level 0 is sized from the smallest box
+    float           m_invCellSize[max_levels] = {};
+    unsigned int    m_numLevels = 0;
+    unsigned int    m_occupiedLevels = 0; // a bit per level with boxes in it, so empty levels are skipped
+    unsigned int    m_tableMask = 0;
+
+    vector<int>     m_bucketHead; // first box in each bucket, -1 if empty
+    vector<int>     m_next; // next box in the same bucket, -1 at the end of the list
+    vector<Cell>    m_boxCells; // the level and cell each box is in
+};
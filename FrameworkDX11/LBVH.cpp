@@ -0,0 +1,261 @@
+#include "LBVH.h"
+#include <algorithm>
+#include <cmath>
+#include <intrin.h>
+
+namespace
+{
+	int countLeadingZeros(const unsigned int x)
+	{
+		unsigned long index;
+		return _BitScanReverse(&index, x) ? 31 - (int)index : 32;
+	}
+}
+
+void LBVH::build(const BoxStore& boxes, ThreadPool& threadPool)
+{
+	m_numBoxes = boxes.size();
+	if (m_numBoxes == 0)
+	{
+		m_nodes.clear();
+		return;
+	}
+
+	m_codes.resize(m_numBoxes);
+	m_indices.resize(m_numBoxes);
+	m_tempCodes.resize(m_numBoxes);
+	m_tempIndices.resize(m_numBoxes);
+	m_nodes.resize(2 * m_numBoxes - 1);
+	m_parents.resize(2 * m_numBoxes - 1);
+	if (m_visitedCapacity < m_numBoxes)
+	{
+		m_visitedCapacity = m_numBoxes;
+		m_visited.reset(new atomic<int>[m_visitedCapacity]);
+	}
+
+	const unsigned int numJobs = std::max(threadPool.threadCount(), 1u); // at least one, or a pool with no workers would leave the tree stale
+
+	threadPool.runJobs(numJobs, [&](const unsigned int job) {
+		unsigned int begin, end;
+		ThreadPool::jobRange(m_numBoxes, numJobs, job, begin, end);
+		computeMortonCodes(boxes, begin, end);
+		});
+
+	radixSort(threadPool);
+
+	const int numInternal = m_numBoxes - 1;
+	m_parents[0] = -1;
+
+	// leaves, and the internal nodes - each is independent of the others
+	threadPool.runJobs(numJobs, [&](const unsigned int job) {
+		unsigned int begin, end;
+		ThreadPool::jobRange(m_numBoxes, numJobs, job, begin, end);
+		for (unsigned int i = begin; i < end; i++)
+		{
+			const XMFLOAT4 p = boxes.positionAndRadius(m_indices[i]);
+			LBVHNode& leaf = m_nodes[numInternal + i];
+			leaf.aabbMin = { p.x - p.w, p.y - p.w, p.z - p.w };
+			leaf.aabbMax = { p.x + p.w, p.y + p.w, p.z + p.w };
+			leaf.left = -1;
+			leaf.right = m_indices[i];
+
+			if ((int)i < numInternal)
+			{
+				m_visited[i] = 0;
+				buildInternalNode(i);
+			}
+		}
+		});
+
+	// bounds, bottom up from every leaf
+	threadPool.runJobs(numJobs, [&](const unsigned int job) {
+		unsigned int begin, end;
+		ThreadPool::jobRange(m_numBoxes, numJobs, job, begin, end);
+		for (unsigned int i = begin; i < end; i++)
+			refitFromLeaf(numInternal + i);
+		});
+}
+
+void LBVH::findPairs(const BoxStore& boxes, ThreadPool& threadPool, vector<vector<CollisionPair>>& threadResults)
+{
+	if (m_numBoxes < 2)
+		return;
+
+	const unsigned int numJobs = threadResults.size();
+	const int numInternal = m_numBoxes - 1;
+
+	threadPool.runJobs(numJobs, [&](const unsigned int job) {
+		vector<CollisionPair>& results = threadResults[job];
+		int stack[128]; // deeper than the tree can get - 30 bits of code plus up to 32 bits of index for duplicates
+
+		unsigned int begin, end;
+		ThreadPool::jobRange(m_numBoxes, numJobs, job, begin, end);
+		for (unsigned int i = begin; i < end; i++)
+		{
+			const int queryLeaf = numInternal + i;
+			const LBVHNode& query = m_nodes[queryLeaf];
+			const XMFLOAT4 a = boxes.positionAndRadius(query.right);
+
+			int stackSize = 0;
+			stack[stackSize++] = 0;
+			while (stackSize > 0)
+			{
+				const int nodeIndex = stack[--stackSize];
+				const LBVHNode& node = m_nodes[nodeIndex];
+
+				if (node.aabbMin.x > query.aabbMax.x || query.aabbMin.x > node.aabbMax.x ||
+					node.aabbMin.y > query.aabbMax.y || query.aabbMin.y > node.aabbMax.y ||
+					node.aabbMin.z > query.aabbMax.z || query.aabbMin.z > node.aabbMax.z)
+					continue;
+
+				if (node.left != -1)
+				{
+					stack[stackSize++] = node.left;
+					stack[stackSize++] = node.right;
+					continue;
+				}
+
+				// each pair is found from both leaves, only keep it from the one earlier in the sorted order
+				if (nodeIndex <= queryLeaf)
+					continue;
+
+				const XMFLOAT4 b = boxes.positionAndRadius(node.right);
+				const float sumRadii = a.w + b.w;
+				if (std::abs(a.x - b.x) < sumRadii && std::abs(a.y - b.y) < sumRadii && std::abs(a.z - b.z) < sumRadii)
+				{
+					const unsigned int box1 = query.right;
+					const unsigned int box2 = node.right;
+					results.push_back(box1 < box2 ? CollisionPair{ box1, box2 } : CollisionPair{ box2, box1 });
+				}
+			}
+		}
+		});
+}
+
+void LBVH::computeMortonCodes(const BoxStore& boxes, const unsigned int begin, const unsigned int end)
+{
+	for (unsigned int i = begin; i < end; i++)
+	{
+		m_codes[i] = mortonKey(boxes.positionAndRadius(i));
+		m_indices[i] = i;
+	}
+}
+
+// A parallel least significant digit radix sort of the codes (and their box indices).
+// Each pass, every job counts the digits in its slice, one scan turns the counts in to write offsets, and every
+// job then scatters its slice. Slices are in order and each job writes its own slice in order, so it's stable.
+void LBVH::radixSort(ThreadPool& threadPool)
+{
+	const unsigned int numJobs = std::max(threadPool.threadCount(), 1u);
+	m_histograms.resize(radix_buckets * numJobs);
+
+	for (int shift = 0; shift < 30; shift += radix_bits)
+	{
+		threadPool.runJobs(numJobs, [&](const unsigned int job) {
+			unsigned int begin, end;
+			ThreadPool::jobRange(m_numBoxes, numJobs, job, begin, end);
+			for (int digit = 0; digit < radix_buckets; digit++)
+				m_histograms[digit * numJobs + job] = 0;
+			for (unsigned int i = begin; i < end; i++)
+				m_histograms[((m_codes[i] >> shift) & (radix_buckets - 1)) * numJobs + job]++;
+			});
+
+		// exclusive scan - small (buckets x jobs) so not worth spreading out
+		unsigned int sum = 0;
+		for (unsigned int& count : m_histograms)
+		{
+			const unsigned int c = count;
+			count = sum;
+			sum += c;
+		}
+
+		threadPool.runJobs(numJobs, [&](const unsigned int job) {
+			unsigned int begin, end;
+			ThreadPool::jobRange(m_numBoxes, numJobs, job, begin, end);
+			for (unsigned int i = begin; i < end; i++)
+			{
+				const unsigned int destination = m_histograms[((m_codes[i] >> shift) & (radix_buckets - 1)) * numJobs + job]++;
+				m_tempCodes[destination] = m_codes[i];
+				m_tempIndices[destination] = m_indices[i];
+			}
+			});
+
+		m_codes.swap(m_tempCodes);
+		m_indices.swap(m_tempIndices);
+	}
+}
+
+// The length of the common prefix of the codes at i and j, or -1 if j is out of range.
+// Duplicate codes are made unique by falling back to the indices themselves.
+int LBVH::commonPrefix(const int i, const int j) const
+{
+	if (j < 0 || j >= (int)m_numBoxes)
+		return -1;
+
+	const unsigned int codeI = m_codes[i];
+	const unsigned int codeJ = m_codes[j];
+	if (codeI == codeJ)
+		return 32 + countLeadingZeros((unsigned int)i ^ (unsigned int)j);
+
+	return countLeadingZeros(codeI ^ codeJ);
+}
+
+void LBVH::buildInternalNode(const int i)
+{
+	const int numInternal = m_numBoxes - 1;
+
+	// which direction does this node's range extend in?
+	const int d = (commonPrefix(i, i + 1) - commonPrefix(i, i - 1)) > 0 ? 1 : -1;
+
+	// find the other end of the range with an exponential then binary search
+	const int minPrefix = commonPrefix(i, i - d);
+	int maxLength = 2;
+	while (commonPrefix(i, i + maxLength * d) > minPrefix)
+		maxLength *= 2;
+
+	int length = 0;
+	for (int t = maxLength / 2; t >= 1; t /= 2)
+	{
+		if (commonPrefix(i, i + (length + t) * d) > minPrefix)
+			length += t;
+	}
+	const int j = i + length * d;
+
+	// find where the range splits - the highest differing bit
+	const int nodePrefix = commonPrefix(i, j);
+	int split = 0;
+	for (int divisor = 2; ; divisor *= 2)
+	{
+		const int t = (length + divisor - 1) / divisor;
+		if (commonPrefix(i, i + (split + t) * d) > nodePrefix)
+			split += t;
+		if (t == 1)
+			break;
+	}
+	const int gamma = i + split * d + std::min(d, 0);
+
+	LBVHNode& node = m_nodes[i];
+	node.left = (std::min(i, j) == gamma) ? numInternal + gamma : gamma;
+	node.right = (std::max(i, j) == gamma + 1) ? numInternal + gamma + 1 : gamma + 1;
+	m_parents[node.left] = i;
+	m_parents[node.right] = i;
+}
+
+// Walk up from a leaf. The first child to reach a node stops, the second knows both children are done and fills it in.
+void LBVH::refitFromLeaf(const unsigned int leaf)
+{
+	int node = m_parents[leaf];
+	while (node != -1)
+	{
+		if (m_visited[node].fetch_add(1, memory_order_acq_rel) == 0)
+			return;
+
+		LBVHNode& parent = m_nodes[node];
+		const LBVHNode& left = m_nodes[parent.left];
+		const LBVHNode& right = m_nodes[parent.right];
+		parent.aabbMin = { std::min(left.aabbMin.x, right.aabbMin.x), std::min(left.aabbMin.y, right.aabbMin.y), std::min(left.aabbMin.z, right.aabbMin.z) };
+		parent.aabbMax = { std::max(left.aabbMax.x, right.aabbMax.x), std::max(left.aabbMax.y, right.aabbMax.y), std::max(left.aabbMax.z, right.aabbMax.z) };
+
+		node = m_parents[node];
+	}
+}
@@ -0,0 +1,79 @@
+// MIT License
+// Copyright (c) 2025 David White
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// A linear BVH (LBVH) broadphase, rebuilt from scratch every frame
+// 1. Each box gets a 30 bit Morton code from its position inside the fixed world bounds
+// 2. The codes are radix sorted in parallel, so boxes close in space are close in the list
+// 3. Every internal node of the hierarchy is built independently (Karras 2012, "Maximizing Parallelism in
+//    the Construction of BVHs, Octrees, and k-d Trees") and the bounds are filled in bottom up
+// 4. Every leaf is then queried against the tree in parallel to find the overlapping pairs
+// Nothing is kept between frames, and every step is a parallel loop over the boxes, which is also
+// how it would map to a compute shader - LBVHNode is laid out to match the struct in computeshader.hlsl.
+
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <memory>
+#include "Box.h"
+#include "BoxStore.h"
+#include "SpaceFillingCurve.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+// 32 bytes, and packed the same as the HLSL version. Internal nodes are [0, N - 2] and leaves [N - 1, 2N - 2].
+// For an internal node, left and right are child node indices. For a leaf, left is -1 and right is the box index.
+struct LBVHNode {
+    XMFLOAT3    aabbMin;
+    int         left;
+    XMFLOAT3    aabbMax;
+    int         right;
+};
+
+class LBVH
+{
+public:
+    LBVH() = default;
+
+    void build(const BoxStore& boxes, ThreadPool& threadPool);
+
+    // each job appends its pairs to its own results vector (one per thread in the pool)
+    // index1 is always less than index2
+    void findPairs(const BoxStore& boxes, ThreadPool& threadPool, vector<vector<CollisionPair>>& threadResults);
+
+    const vector<LBVHNode>& getNodes() const { return m_nodes; }
+
+private:
+    void computeMortonCodes(const BoxStore& boxes, const unsigned int begin, const unsigned int end);
+    void radixSort(ThreadPool& threadPool);
+    void buildInternalNode(const int i);
+    void refitFromLeaf(const unsigned int leaf);
+    int  commonPrefix(const int i, const int j) const;
+
+private:
+    static constexpr int radix_bits = 10; // 3 passes of 10 bits covers the 30 bit codes
+    static constexpr int radix_buckets = 1 << radix_bits;
+
+    unsigned int            m_numBoxes = 0;
+    vector<unsigned int>    m_codes;
+    vector<unsigned int>    m_indices; // the box index for each sorted code
+    vector<unsigned int>    m_tempCodes;
+    vector<unsigned int>    m_tempIndices;
+    vector<unsigned int>    m_histograms; // per job digit counts, digit major so a single scan gives every job's offsets
+
+    vector<LBVHNode>        m_nodes;
+    vector<int>             m_parents;
+    unique_ptr<atomic<int>[]> m_visited; // per internal node, so only the second child to arrive refits it
+    unsigned int            m_visitedCapacity = 0;
+};
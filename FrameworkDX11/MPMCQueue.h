@@ -0,0 +1,123 @@
+// MIT License
+// Copyright (c) 2025 David White
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// Dmitry Vyukov's bounded multi producer, multi consumer queue. Every cell has a sequence number that says whether it
+// is ready to be written or read on the current lap of the ring, so a push or pop is one compare and swap on the shared
+// position plus a store to the cell - no locks, and producers and consumers only meet on the cells they share.
+// The capacity is fixed (a power of two) and push fails when it is full.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+template <typename T>
+class MPMCQueue
+{
+public:
+    explicit MPMCQueue(const std::size_t capacity) : m_cells(new Cell[capacity]), m_mask(capacity - 1)
+    {
+        for (std::size_t i = 0; i < capacity; i++)
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    MPMCQueue(const MPMCQueue&) = delete;
+    MPMCQueue& operator=(const MPMCQueue&) = delete;
+
+    // The item is only moved from if there was room
+    bool push(T&& item)
+    {
+        Cell* cell;
+        std::size_t position = m_enqueuePosition.load(std::memory_order_relaxed);
+        while (true)
+        {
+            cell = &m_cells[position & m_mask];
+            const std::size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            const std::ptrdiff_t lap = (std::ptrdiff_t)sequence - (std::ptrdiff_t)position;
+            if (lap == 0)
+            {
+                // the cell is free on this lap - claim it
+                if (m_enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (lap < 0)
+            {
+                // still holding an item from the last lap, so it's full
+                return false;
+            }
+            else
+            {
+                // another producer got there first
+                position = m_enqueuePosition.load(std::memory_order_relaxed);
+            }
+        }
+
+        cell->data = std::move(item);
+        cell->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& item)
+    {
+        Cell* cell;
+        std::size_t position = m_dequeuePosition.load(std::memory_order_relaxed);
+        while (true)
+        {
+            cell = &m_cells[position & m_mask];
+            const std::size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            const std::ptrdiff_t lap = (std::ptrdiff_t)sequence - (std::ptrdiff_t)(position + 1);
+            if (lap == 0)
+            {
+                if (m_dequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (lap < 0)
+            {
+                // nothing written here yet, so it's empty
+                return false;
+            }
+            else
+            {
+                position = m_dequeuePosition.load(std::memory_order_relaxed);
+            }
+        }
+
+        item = std::move(cell->data);
+        // free for the producers on the next lap
+        cell->sequence.store(position + m_mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Only a hint while other threads are using it
+    std::size_t approximateSize() const
+    {
+        const std::size_t enqueued = m_enqueuePosition.load(std::memory_order_relaxed);
+        const std::size_t dequeued = m_dequeuePosition.load(std::memory_order_relaxed);
+        return enqueued > dequeued ? enqueued - dequeued : 0;
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<std::size_t>    sequence;
+        T                           data;
+    };
+
+    std::unique_ptr<Cell[]>                 m_cells;
+    const std::size_t                       m_mask;
+    // the producers' and consumers' positions on their own cache lines
+    alignas(64) std::atomic<std::size_t>    m_enqueuePosition{ 0 };
+    alignas(64) std::atomic<std::size_t>    m_dequeuePosition{ 0 };
+};
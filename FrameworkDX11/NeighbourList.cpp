@@ -0,0 +1,86 @@
+#include "NeighbourList.h"
+#include <algorithm>
+#include <cmath>
+
+bool NeighbourList::update(const BoxStore& boxes, ThreadPool& threadPool)
+{
+	if (m_buildPositions.size() != boxes.size() || hasMovedTooFar(boxes, threadPool))
+	{
+		rebuild(boxes, threadPool);
+		m_framesSinceRebuild = 0;
+		return true;
+	}
+
+	m_framesSinceRebuild++;
+	return false;
+}
+
+void NeighbourList::findPairs(const BoxStore& boxes, ThreadPool& threadPool, vector<vector<CollisionPair>>& threadResults)
+{
+	const unsigned int numJobs = threadResults.size();
+	const unsigned int numCandidates = m_candidates.size();
+
+	threadPool.runJobs(numJobs, [&](const unsigned int job) {
+		vector<CollisionPair>& results = threadResults[job];
+
+		unsigned int begin, end;
+		ThreadPool::jobRange(numCandidates, numJobs, job, begin, end);
+		for (unsigned int c = begin; c < end; c++)
+		{
+			const CollisionPair& candidate = m_candidates[c];
+			const XMFLOAT4 a = boxes.positionAndRadius(candidate.index1);
+			const XMFLOAT4 b = boxes.positionAndRadius(candidate.index2);
+			const float sumRadii = a.w + b.w;
+			if (std::abs(a.x - b.x) < sumRadii && std::abs(a.y - b.y) < sumRadii && std::abs(a.z - b.z) < sumRadii)
+				results.push_back(candidate);
+		}
+		});
+}
+
+// Two boxes that were more than (radii + skin) apart at the last build can only touch now if, between them,
+// they've moved more than the skin - so it's safe as long as no box has moved more than half of it
+bool NeighbourList::hasMovedTooFar(const BoxStore& boxes, ThreadPool& threadPool)
+{
+	const unsigned int numJobs = std::max(threadPool.threadCount(), 1u); // at least one, or a pool with no workers would never flag a rebuild
+	m_jobMovedTooFar.assign(numJobs, 0);
+
+	const float limitSq = (0.5f * skin) * (0.5f * skin);
+
+	threadPool.runJobs(numJobs, [&](const unsigned int job) {
+		unsigned int begin, end;
+		ThreadPool::jobRange(boxes.size(), numJobs, job, begin, end);
+		for (unsigned int i = begin; i < end; i++)
+		{
+			const XMFLOAT4 p = boxes.positionAndRadius(i);
+			const XMFLOAT3& p0 = m_buildPositions[i];
+			const float dx = p.x - p0.x;
+			const float dy = p.y - p0.y;
+			const float dz = p.z - p0.z;
+			if (dx * dx + dy * dy + dz * dz > limitSq)
+			{
+				m_jobMovedTooFar[job] = 1;
+				return;
+			}
+		}
+		});
+
+	for (unsigned char moved : m_jobMovedTooFar)
+	{
+		if (moved)
+			return true;
+	}
+	return false;
+}
+
+void NeighbourList::rebuild(const BoxStore& boxes, ThreadPool& threadPool)
+{
+	m_cellList.build(boxes, threadPool, skin);
+	m_cellList.findPairs(boxes, threadPool, m_candidates);
+
+	m_buildPositions.resize(boxes.size());
+	for (unsigned int i = 0; i < boxes.size(); i++)
+	{
+		const XMFLOAT4 p = boxes.positionAndRadius(i);
+		m_buildPositions[i] = { p.x, p.y, p.z };
+	}
+}
@@ -0,0 +1,60 @@
+// MIT License
+// Copyright (c) 2025 David White
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// Verlet neighbour lists (as used in molecular dynamics)
+// Rather than running a broadphase every frame, the cell list is built with every box padded by a 'skin', which gives
+// each box a list of candidates within 2 * radius + skin of it. A pair can't go from further apart than that to
+// touching until one of the boxes has moved more than skin / 2, so until then only the cached candidates need checking.
+// Boxes resting on the floor barely move, so most frames are just the (cheap, parallel) check of the candidates.
+
+#pragma once
+
+#include <vector>
+#include "Box.h"
+#include "BoxStore.h"
+#include "CellList.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+class NeighbourList
+{
+public:
+    NeighbourList() = default;
+
+    // rebuilds the lists if any box has moved far enough (or the box count has changed), returns true if it did
+    bool update(const BoxStore& boxes, ThreadPool& threadPool);
+
+    // checks the cached candidates, each job appends its pairs to its own results vector (one per thread in the pool)
+    // index1 is always less than index2
+    void findPairs(const BoxStore& boxes, ThreadPool& threadPool, vector<vector<CollisionPair>>& threadResults);
+
+    // forces a rebuild on the next update, for when the boxes have been replaced rather than moved
+    void invalidate() { m_buildPositions.clear(); }
+
+    unsigned int getCandidateCount() const { return m_candidates.size(); }
+    unsigned int getFramesSinceRebuild() const { return m_framesSinceRebuild; }
+
+private:
+    bool hasMovedTooFar(const BoxStore& boxes, ThreadPool& threadPool);
+    void rebuild(const BoxStore& boxes, ThreadPool& threadPool);
+
+private:
+    static constexpr float skin = 0.5f * box_scale;
+
+    CellList                m_cellList;
+    vector<CollisionPair>   m_candidates; // in index1 order, so this is every box's list one after another
+    vector<XMFLOAT3>        m_buildPositions; // where each box was when the lists were built
+    vector<unsigned char>   m_jobMovedTooFar;
+    unsigned int            m_framesSinceRebuild = 0;
+};
@@ -108,10 +108,10 @@ void Scene::update(const float deltaTime)
 
     for (unsigned int i = 0; i < box_count; i++)
     {
-        Box* pBox = m_colliderManager.getBox(i);
+        const BoxView box = m_colliderManager.getBox(i);
 
-        cube->setPosition(XMFLOAT3(pBox->positionAndRadius.x, pBox->positionAndRadius.y, pBox->positionAndRadius.z));
-        cube->setScale(pBox->positionAndRadius.w);
+        cube->setPosition(box.position());
+        cube->setScale(box.radius());
 
         cube->update(deltaTime, m_pImmediateContext.Get());
 
@@ -0,0 +1,93 @@
+// MIT License
+// Copyright (c) 2025 David White
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+
+// Keys along a space-filling curve through the world bounds, for sorting boxes so boxes close in space are close
+// in the list. Each axis is quantized to 10 bits and the three are interleaved in to a 30 bit key.
+// Morton (Z order) is just the interleaved bits - cheap, but it jumps across the world at every power of two.
+// Hilbert reflects and rotates each octant first so consecutive keys are always neighbouring cells, which keeps runs
+// of the list more compact, for a few more operations per key.
+
+#pragma once
+
+#include <algorithm>
+#include <DirectXMath.h>
+#include "Box.h"
+
+using namespace DirectX;
+
+constexpr int curve_bits = 10; // per axis
+
+// spread the lower 10 bits out so there are two zero bits between each
+inline unsigned int expandCurveBits(unsigned int v)
+{
+    v = (v * 0x00010001u) & 0xFF0000FFu;
+    v = (v * 0x00000101u) & 0x0F00F00Fu;
+    v = (v * 0x00000011u) & 0xC30C30C3u;
+    v = (v * 0x00000005u) & 0x49249249u;
+    return v;
+}
+
+// the cell a position falls in, on a 1024 cell grid over the world bounds - boxes that have strayed outside are
+// clamped to the edge
+inline void curveCell(const XMFLOAT4& position, unsigned int cell[3])
+{
+    const float x = std::min(std::max((position.x - minX) / (maxX - minX), 0.0f), 1.0f);
+    const float y = std::min(std::max((position.y - minY) / (maxY - minY), 0.0f), 1.0f);
+    const float z = std::min(std::max((position.z - minZ) / (maxZ - minZ), 0.0f), 1.0f);
+
+    cell[0] = (unsigned int)(x * 1023.0f);
+    cell[1] = (unsigned int)(y * 1023.0f);
+    cell[2] = (unsigned int)(z * 1023.0f);
+}
+
+inline unsigned int mortonKey(const XMFLOAT4& position)
+{
+    unsigned int cell[3];
+    curveCell(position, cell);
+    return expandCurveBits(cell[0]) * 4 + expandCurveBits(cell[1]) * 2 + expandCurveBits(cell[2]);
+}
+
+// Skilling's transform (2004, "Programming the Hilbert curve") turns the cell in to the 'transposed' Hilbert index,
+// whose bits then interleave the same way as a Morton key
+inline unsigned int hilbertKey(const XMFLOAT4& position)
+{
+    unsigned int cell[3];
+    curveCell(position, cell);
+
+    // undo the excess work - at each level, reflect the lower bits of x where the axis has the bit set, or swap them
+    // between x and the axis where it doesn't. With masks rather than branches, as the bits are as good as random.
+    for (int bit = curve_bits - 1; bit > 0; bit--)
+    {
+        const unsigned int p = (1u << bit) - 1;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            const unsigned int reflect = 0u - ((cell[axis] >> bit) & 1u);
+            const unsigned int t = (cell[0] ^ cell[axis]) & p & ~reflect;
+            cell[0] ^= t | (p & reflect);
+            cell[axis] ^= t;
+        }
+    }
+
+    // gray encode
+    cell[1] ^= cell[0];
+    cell[2] ^= cell[1];
+    unsigned int t = 0;
+    for (int bit = curve_bits - 1; bit > 0; bit--)
+        t ^= (0u - ((cell[2] >> bit) & 1u)) & ((1u << bit) - 1);
+    cell[0] ^= t;
+    cell[1] ^= t;
+    cell[2] ^= t;
+
+    return expandCurveBits(cell[0]) * 4 + expandCurveBits(cell[1]) * 2 + expandCurveBits(cell[2]);
+}
@@ -0,0 +1,82 @@
+#include "SpatialGrid.h"
+#include <cmath>
+#include <algorithm>
+
+void SpatialGrid::build(const BoxStore& boxes)
+{
+	const unsigned int numBoxes = boxes.size();
+
+	// cells are sized from the box diameter, but must grow if any box is bigger than box_scale
+	// otherwise two overlapping boxes could be more than one cell apart
+	float maxRadius = box_scale;
+	for (unsigned int i = 0; i < numBoxes; i++)
+		maxRadius = std::max(maxRadius, boxes.radius()[i]);
+
+	m_cellSize = 2.0f * maxRadius;
+	m_invCellSize = 1.0f / m_cellSize;
+
+	// keep the table at least twice the box count (and a power of two so the hash can be masked)
+	unsigned int tableSize = 64;
+	while (tableSize < numBoxes * 2)
+		tableSize <<= 1;
+	m_tableMask = tableSize - 1;
+
+	m_bucketHead.assign(tableSize, -1);
+	m_next.resize(numBoxes);
+	m_boxCells.resize(numBoxes);
+
+	// push each box on to the front of its bucket's list
+	for (unsigned int i = 0; i < numBoxes; i++)
+	{
+		Cell cell = cellFor(boxes.positionAndRadius(i));
+		unsigned int bucket = hashCell(cell.x, cell.y, cell.z);
+
+		m_boxCells[i] = cell;
+		m_next[i] = m_bucketHead[bucket];
+		m_bucketHead[bucket] = i;
+	}
+}
+
+void SpatialGrid::query(const unsigned int boxIndex, vector<unsigned int>& candidates) const
+{
+	candidates.clear();
+
+	const Cell& home = m_boxCells[boxIndex];
+
+	for (int dz = -1; dz <= 1; dz++)
+	{
+		for (int dy = -1; dy <= 1; dy++)
+		{
+			for (int dx = -1; dx <= 1; dx++)
+			{
+				const int cx = home.x + dx;
+				const int cy = home.y + dy;
+				const int cz = home.z + dz;
+
+				for (int j = m_bucketHead[hashCell(cx, cy, cz)]; j != -1; j = m_next[j])
+				{
+					// only boxes later in the list (matching the all pairs loops), and only ones actually in this cell -
+					// different cells can hash to the same bucket, which would otherwise give duplicates
+					const Cell& other = m_boxCells[j];
+					if ((unsigned int)j > boxIndex && other.x == cx && other.y == cy && other.z == cz)
+						candidates.push_back(j);
+				}
+			}
+		}
+	}
+}
+
+SpatialGrid::Cell SpatialGrid::cellFor(const XMFLOAT4& positionAndRadius) const
+{
+	return {
+		(int)std::floor(positionAndRadius.x * m_invCellSize),
+		(int)std::floor(positionAndRadius.y * m_invCellSize),
+		(int)std::floor(positionAndRadius.z * m_invCellSize) };
+}
+
+unsigned int SpatialGrid::hashCell(const int x, const int y, const int z) const
+{
+	// the usual large primes from Teschner et al. "Optimized Spatial Hashing for Collision Detection of Deformable Objects"
+	const unsigned int hash = ((unsigned int)x * 73856093u) ^ ((unsigned int)y * 19349663u) ^ ((unsigned int)z * 83492791u);
+	return hash & m_tableMask;
+}
@@ -0,0 +1,60 @@
+// MIT License
+// Copyright (c) 2025 David White
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// A uniform spatial hash grid broadphase
+// Space is split into cubic cells at least as wide as the largest box, so two overlapping boxes are always
+// in the same or neighbouring cells. Each box then only needs testing against the 27 cells around it.
+// Cells are hashed into a fixed size table (so the world doesn't need to be bounded) and each bucket is an
+// intrusive linked list through m_next, which makes a rebuild O(N) with no allocations once warmed up.
+
+#pragma once
+
+#include <vector>
+#include "Box.h"
+#include "BoxStore.h"
+
+using namespace std;
+
+class SpatialGrid
+{
+public:
+    SpatialGrid() = default;
+
+    // re-bucket every box, call once per frame after the boxes have moved
+    void build(const BoxStore& boxes);
+
+    // gathers the indices of every box later in the list (j > boxIndex) that shares a neighbouring cell with boxIndex
+    // these are only candidates - the caller still needs to do the actual collision check
+    void query(const unsigned int boxIndex, vector<unsigned int>& candidates) const;
+
+    float getCellSize() const { return m_cellSize; }
+
+private:
+    struct Cell {
+        int x;
+        int y;
+        int z;
+    };
+
+    Cell cellFor(const XMFLOAT4& positionAndRadius) const;
+    unsigned int hashCell(const int x, const int y, const int z) const;
+
+private:
+    float           m_cellSize = 2.0f * box_scale;
+    float           m_invCellSize = 1.0f / (2.0f * box_scale);
+    unsigned int    m_tableMask = 0;
+
+    vector<int>     m_bucketHead; // first box in each bucket, -1 if empty
+    vector<int>     m_next; // next box in the same bucket, -1 at the end of the list
+    vector<Cell>    m_boxCells; // the cell each box is in, used to reject other cells sharing a bucket
+};
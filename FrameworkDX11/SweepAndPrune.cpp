@@ -0,0 +1,137 @@
+#include "SweepAndPrune.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+// The endpoints are moved out by this much of the box's |x| + radius. That is more than the rounding in the endpoints
+// and in checkCollision's |a.x - b.x| < a.r + b.r put together, so every pair checkCollision finds overlaps on X in
+// the list - the padding only adds pairs that findPairs' X test then drops
+constexpr float endpoint_padding = 2.0f * FLT_EPSILON;
+
+// Drops the endpoints of boxes that have gone and adds endpoints on the end for boxes the list doesn't have yet,
+// so boxes coming and going don't lose the order of the rest. Returns where the new endpoints start.
+unsigned int SweepAndPrune::addAndRemoveBoxes(const BoxStore& boxes)
+{
+	m_hasEndpoints.assign(boxes.size(), 0);
+
+	unsigned int kept = 0;
+	for (const Endpoint& endpoint : m_endpoints)
+	{
+		if (endpoint.boxIndex >= boxes.size())
+			continue;
+
+		m_hasEndpoints[endpoint.boxIndex] = 1;
+		m_endpoints[kept++] = endpoint;
+	}
+	m_endpoints.resize(kept);
+
+	for (unsigned int i = 0; i < boxes.size(); i++)
+	{
+		if (!m_hasEndpoints[i])
+		{
+			m_endpoints.push_back({ 0.0f, i, 1 });
+			m_endpoints.push_back({ 0.0f, i, 0 });
+		}
+	}
+	return kept;
+}
+
+void SweepAndPrune::update(const BoxStore& boxes)
+{
+	unsigned int firstNew = m_endpoints.size();
+	if (m_endpoints.size() != boxes.size() * 2)
+		firstNew = addAndRemoveBoxes(boxes);
+
+	// refresh the values in place - the order of the list is kept from the last frame
+	for (Endpoint& endpoint : m_endpoints)
+	{
+		const XMFLOAT4 positionAndRadius = boxes.positionAndRadius(endpoint.boxIndex);
+		const float padding = endpoint_padding * (std::abs(positionAndRadius.x) + positionAndRadius.w);
+		endpoint.value = endpoint.isMin ? positionAndRadius.x - positionAndRadius.w - padding : positionAndRadius.x + positionAndRadius.w + padding;
+	}
+
+	// insertion sort - cheap when the list is nearly sorted
+	unsigned int swaps = 0;
+	for (unsigned int i = 1; i < firstNew; i++)
+	{
+		Endpoint key = m_endpoints[i];
+		int j = i - 1;
+		while (j >= 0 && lessThan(key, m_endpoints[j]))
+		{
+			m_endpoints[j + 1] = m_endpoints[j];
+			j--;
+			swaps++;
+		}
+		m_endpoints[j + 1] = key;
+	}
+	m_lastSwapCount = swaps;
+
+	// new boxes have no coherence to exploit, so they get a full sort of their own and are merged in
+	if (firstNew < m_endpoints.size())
+	{
+		std::sort(m_endpoints.begin() + firstNew, m_endpoints.end(), lessThan);
+		std::inplace_merge(m_endpoints.begin(), m_endpoints.begin() + firstNew, m_endpoints.end(), lessThan);
+	}
+}
+
+void SweepAndPrune::remapBoxes(const vector<unsigned int>& newIndex)
+{
+	// boxes beyond the end of newIndex are ones the remap doesn't know about, so they go too - update adds back any
+	// that are still there
+	unsigned int kept = 0;
+	for (const Endpoint& endpoint : m_endpoints)
+	{
+		if (endpoint.boxIndex >= newIndex.size())
+			continue;
+
+		const unsigned int boxIndex = newIndex[endpoint.boxIndex];
+		if (boxIndex == removed_box)
+			continue;
+
+		m_endpoints[kept] = endpoint;
+		m_endpoints[kept].boxIndex = boxIndex;
+		kept++;
+	}
+	m_endpoints.resize(kept);
+}
+
+void SweepAndPrune::findPairs(const BoxStore& boxes, vector<CollisionPair>& results)
+{
+	m_active.clear();
+	m_activeSlot.resize(boxes.size());
+
+	for (const Endpoint& endpoint : m_endpoints)
+	{
+		const unsigned int boxIndex = endpoint.boxIndex;
+
+		if (!endpoint.isMin)
+		{
+			// the box's interval has closed, swap remove it from the active list
+			const unsigned int slot = m_activeSlot[boxIndex];
+			const unsigned int last = m_active.back();
+			m_active[slot] = last;
+			m_activeSlot[last] = slot;
+			m_active.pop_back();
+			continue;
+		}
+
+		// every active box overlaps this one on X, so it is mostly Y and Z left to check
+		// (X is re-tested in the same form as checkCollision, as the padded endpoints overlap a little more)
+		const XMFLOAT4 a = boxes.positionAndRadius(boxIndex);
+		for (unsigned int other : m_active)
+		{
+			const XMFLOAT4 b = boxes.positionAndRadius(other);
+			const float sumRadii = a.w + b.w;
+			if (std::abs(a.y - b.y) < sumRadii && std::abs(a.z - b.z) < sumRadii && std::abs(a.x - b.x) < sumRadii)
+			{
+				if (boxIndex < other)
+					results.push_back({ boxIndex, other });
+				else
+					results.push_back({ other, boxIndex });
+			}
+		}
+
+		m_activeSlot[boxIndex] = m_active.size();
+		m_active.push_back(boxIndex);
+	}
+}
@@ -0,0 +1,70 @@
+// MIT License
+// Copyright (c) 2025 David White
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// An incremental sweep and prune (sort and sweep) broadphase along the X axis
+// The min / max X endpoints of every box are kept in one sorted list that persists between frames.
+// Boxes only move a little each frame, so the list is nearly sorted already and an insertion sort
+// puts it back in order in roughly O(N) rather than the O(N log N) of a full sort.
+// The sweep then walks the list keeping a set of 'active' boxes whose X intervals are open - only these
+// can overlap the box being opened, and they are pruned further on Y and Z.
+
+#pragma once
+
+#include <vector>
+#include "Box.h"
+#include "BoxStore.h"
+
+using namespace std;
+
+class SweepAndPrune
+{
+public:
+    SweepAndPrune() = default;
+
+    // refresh the endpoints from the (moved) boxes and re-sort them
+    // if the number of boxes has changed, boxes that have gone are dropped and new ones sorted and merged in
+    void update(const BoxStore& boxes);
+
+    // appends every pair of boxes whose AABBs overlap (the same test as ColliderManager::checkCollision)
+    // index1 is always less than index2
+    void findPairs(const BoxStore& boxes, vector<CollisionPair>& results);
+
+    // the boxes have been reordered - box i is now at newIndex[i] (or removed_box). The list keeps its order, so
+    // there is no full sort to redo.
+    void remapBoxes(const vector<unsigned int>& newIndex);
+
+    // the number of endpoint swaps the last insertion sort needed - a measure of how coherent the frame was
+    unsigned int getLastSwapCount() const { return m_lastSwapCount; }
+
+private:
+    struct Endpoint {
+        float           value;
+        unsigned int    boxIndex : 31;
+        unsigned int    isMin : 1;
+    };
+
+    unsigned int addAndRemoveBoxes(const BoxStore& boxes);
+
+    // the sort order - on equal values a max comes before a min, so touching boxes are not reported (as with checkCollision's <)
+    static bool lessThan(const Endpoint& a, const Endpoint& b)
+    {
+        return a.value < b.value || (a.value == b.value && a.isMin < b.isMin);
+    }
+
+private:
+    vector<Endpoint>        m_endpoints;
+    vector<unsigned int>    m_active; // boxes whose X interval is currently open during the sweep
+    vector<unsigned int>    m_activeSlot; // where each box sits in m_active, so it can be removed in O(1)
+    vector<unsigned char>   m_hasEndpoints; // for addAndRemoveBoxes
+    unsigned int            m_lastSwapCount = 0;
+};
@@ -0,0 +1,155 @@
+// MIT License
+// Copyright (c) 2025 David White
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// A move only void() task that keeps its function inline, so queueing a lambda never allocates the way a std::function
+// with a few captures can. Anything bigger than storage_size is a compile error rather than a quiet allocation - capture
+// a pointer or reference to the data instead. Plus TaskRing, a fixed size ring buffer of them.
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+class Task
+{
+public:
+    // enough for a handful of pointers or a shared_ptr, and with the ops pointer a Task fills one cache line
+    static constexpr std::size_t storage_size = 48;
+
+    Task() = default;
+
+    template <typename F, typename = std::enable_if_t<!std::is_same<std::decay_t<F>, Task>::value>>
+    Task(F&& function)
+    {
+        using Function = std::decay_t<F>;
+        static_assert(sizeof(Function) <= storage_size, "the task's captures don't fit in a Task - capture a pointer to them instead");
+        static_assert(alignof(Function) <= alignof(std::max_align_t), "the task's captures are over aligned for a Task");
+        static_assert(std::is_nothrow_move_constructible<Function>::value, "a Task's function has to move without throwing");
+
+        new (m_storage) Function(std::forward<F>(function));
+        m_ops = opsFor<Function>();
+    }
+
+    Task(Task&& other) noexcept { moveFrom(other); }
+
+    Task& operator=(Task&& other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            moveFrom(other);
+        }
+        return *this;
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task() { reset(); }
+
+    explicit operator bool() const { return m_ops != nullptr; }
+
+    void operator()() { m_ops->invoke(m_storage); }
+
+    // destroys the function, and whatever it captured, now rather than when the Task is reused
+    void reset()
+    {
+        if (m_ops)
+        {
+            m_ops->destroy(m_storage);
+            m_ops = nullptr;
+        }
+    }
+
+private:
+    struct Ops
+    {
+        void (*invoke)(void* function);
+        void (*move)(void* to, void* from); // also destroys the moved from function
+        void (*destroy)(void* function);
+    };
+
+    template <typename Function>
+    static void invokeFunction(void* function) { (*static_cast<Function*>(function))(); }
+
+    template <typename Function>
+    static void moveFunction(void* to, void* from)
+    {
+        new (to) Function(std::move(*static_cast<Function*>(from)));
+        static_cast<Function*>(from)->~Function();
+    }
+
+    template <typename Function>
+    static void destroyFunction(void* function) { static_cast<Function*>(function)->~Function(); }
+
+    template <typename Function>
+    static const Ops* opsFor()
+    {
+        static constexpr Ops ops = { &invokeFunction<Function>, &moveFunction<Function>, &destroyFunction<Function> };
+        return &ops;
+    }
+
+    void moveFrom(Task& other)
+    {
+        if (other.m_ops)
+        {
+            other.m_ops->move(m_storage, other.m_storage);
+            m_ops = other.m_ops;
+            other.m_ops = nullptr;
+        }
+    }
+
+    alignas(std::max_align_t) unsigned char m_storage[storage_size];
+    const Ops*                              m_ops = nullptr;
+};
+
+// A ring buffer of tasks with a fixed capacity (a power of two), allocated once - push fails when it is full rather than
+// growing. It isn't thread safe, the owner locks around it.
+class TaskRing
+{
+public:
+    explicit TaskRing(const unsigned int capacity) : m_tasks(new Task[capacity]), m_mask(capacity - 1) {}
+
+    bool push(Task&& task)
+    {
+        if (m_size > m_mask)
+            return false;
+
+        m_tasks[(m_head + m_size) & m_mask] = std::move(task);
+        m_size++;
+        return true;
+    }
+
+    bool pop(Task& task)
+    {
+        if (m_size == 0)
+            return false;
+
+        task = std::move(m_tasks[m_head]);
+        m_head = (m_head + 1) & m_mask;
+        m_size--;
+        return true;
+    }
+
+    unsigned int size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+private:
+    std::unique_ptr<Task[]> m_tasks;
+    const unsigned int      m_mask;
+    unsigned int            m_head = 0;
+    unsigned int            m_size = 0;
+};
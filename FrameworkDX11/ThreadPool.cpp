@@ -1 +1,327 @@
 #include "ThreadPool.h"
+
+// Which pool and worker the current thread is, so enqueue can tell a worker's own tasks from outside ones
+static thread_local const ThreadPool* t_pool = nullptr;
+static thread_local unsigned int t_workerIndex = 0;
+static thread_local unsigned int t_randomState = 0;
+
+// This thread's last few parallelFor loops, to use again once their helpers have all finished with them
+constexpr unsigned int cached_loops = 4;
+static thread_local std::shared_ptr<void> t_loops[cached_loops];
+static thread_local unsigned int t_nextLoop = 0;
+
+ThreadPool::ThreadPool(const unsigned int numThreads, const int queueType) : m_queueType(queueType)
+{
+	if (m_queueType == task_queue_lock_free)
+		m_lockFreeInjectedTasks = std::make_unique<MPMCQueue<Task>>(injection_capacity);
+	else
+		m_injectedTasks = std::make_unique<TaskRing>(injection_capacity);
+
+	// all the queues exist before any worker can look for one to steal from
+	for (unsigned int i = 0; i < numThreads; ++i)
+		m_queues.push_back(std::make_unique<WorkerQueue>());
+
+	for (unsigned int i = 0; i < numThreads; ++i)
+		m_workers.emplace_back([this, i] { workerLoop(i); });
+}
+
+ThreadPool::~ThreadPool()
+{
+	m_stop = true;
+	m_taskEvents.notifyAll();
+	for (std::thread& worker : m_workers)
+	{
+		worker.join();
+	}
+}
+
+void ThreadPool::enqueueTask(Task&& task)
+{
+	// with no workers nothing would ever take it off a queue
+	const bool hasWorkers = !m_queues.empty();
+	bool queued = hasWorkers && t_pool == this && pushLocal(t_workerIndex, std::move(task));
+	if (!queued && hasWorkers && m_lockFreeInjectedTasks)
+	{
+		queued = m_lockFreeInjectedTasks->push(std::move(task));
+	}
+	else if (!queued && hasWorkers)
+	{
+		std::unique_lock<std::mutex> lock(m_injectionMutex);
+		queued = m_injectedTasks->push(std::move(task));
+		m_injectedCount.store(m_injectedTasks->size(), std::memory_order_relaxed);
+	}
+
+	if (!queued)
+	{
+		// no workers, or every queue is full - so the caller runs it
+		task();
+		return;
+	}
+
+	m_queuedTasks.fetch_add(1);
+	m_taskEvents.notify(1);
+}
+
+// Queues up to copies copies of one task, with a single lock (or none, from a worker of this pool, which puts them on its
+// own deque for the others to steal, or with the lock free queue) and one wake up. Returns how many there was room for.
+template <typename F>
+unsigned int ThreadPool::enqueueCopies(const F& function, const unsigned int copies)
+{
+	if (m_queues.empty())
+		return 0;
+
+	unsigned int queued = 0;
+	if (t_pool == this)
+	{
+		while (queued < copies && pushLocal(t_workerIndex, Task(function)))
+			queued++;
+	}
+	if (queued < copies && m_lockFreeInjectedTasks)
+	{
+		while (queued < copies && m_lockFreeInjectedTasks->push(Task(function)))
+			queued++;
+	}
+	else if (queued < copies)
+	{
+		std::unique_lock<std::mutex> lock(m_injectionMutex);
+		while (queued < copies && m_injectedTasks->push(Task(function)))
+			queued++;
+		m_injectedCount.store(m_injectedTasks->size(), std::memory_order_relaxed);
+	}
+
+	m_queuedTasks.fetch_add(queued);
+	m_taskEvents.notify(queued);
+	return queued;
+}
+
+// Puts the task in the worker's next slot and on its deque - unless that slot's last task hasn't run yet, when they
+// are all in use. The task is only moved from if it fits.
+bool ThreadPool::pushLocal(const unsigned int index, Task&& task)
+{
+	if (!hasFreeSlot(index))
+		return false;
+
+	WorkerQueue& queue = *m_queues[index];
+	TaskSlot& slot = queue.slots[queue.nextSlot];
+	slot.task = std::move(task);
+	slot.queued.store(true, std::memory_order_relaxed);
+	queue.nextSlot = (queue.nextSlot + 1) % local_task_capacity;
+	queue.deque.push(&slot);
+	return true;
+}
+
+bool ThreadPool::hasFreeSlot(const unsigned int index) const
+{
+	const WorkerQueue& queue = *m_queues[index];
+	return !queue.slots[queue.nextSlot].queued.load(std::memory_order_acquire);
+}
+
+// How many tasks are waiting in the injection queue - only a hint, as it can change at any time
+unsigned int ThreadPool::injectedTaskCount() const
+{
+	if (m_lockFreeInjectedTasks)
+		return (unsigned int)m_lockFreeInjectedTasks->approximateSize();
+	return m_injectedCount.load(std::memory_order_relaxed);
+}
+
+void ThreadPool::runParallelFor(const unsigned int count, const unsigned int grain, const unsigned int chunkCount, void (*run)(const void*, const unsigned int, const unsigned int), const void* body)
+{
+	std::shared_ptr<ParallelLoop> loop;
+	for (const std::shared_ptr<void>& cached : t_loops)
+	{
+		// nothing but the cache has it - no helper still to run, and it isn't a loop this one is inside
+		if (cached && cached.use_count() == 1)
+		{
+			std::atomic_thread_fence(std::memory_order_acquire);
+			loop = std::static_pointer_cast<ParallelLoop>(cached);
+			break;
+		}
+	}
+	if (!loop)
+	{
+		loop = std::make_shared<ParallelLoop>();
+		t_loops[t_nextLoop] = loop;
+		t_nextLoop = (t_nextLoop + 1) % cached_loops;
+	}
+	loop->count = count;
+	loop->grain = grain;
+	loop->chunkCount = chunkCount;
+	loop->run = run;
+	loop->body = body;
+	loop->nextChunk.store(0, std::memory_order_relaxed);
+	loop->chunksLeft.reset(chunkCount);
+
+	// the caller takes chunks too, so one fewer helper than chunks is enough - and if the queues are too full for them
+	// all, the caller just takes more of the chunks
+	const unsigned int helpers = std::min(threadCount(), chunkCount - 1);
+	enqueueCopies([loop] { runChunks(*loop); }, helpers);
+
+	runChunks(*loop);
+	loop->chunksLeft.wait(m_adaptiveSpin.load(std::memory_order_relaxed) ? latch_spin_microseconds : 0.0f);
+}
+
+void ThreadPool::runChunks(ParallelLoop& loop)
+{
+	for (unsigned int chunk = loop.nextChunk.fetch_add(1, std::memory_order_relaxed); chunk < loop.chunkCount; chunk = loop.nextChunk.fetch_add(1, std::memory_order_relaxed))
+	{
+		const unsigned int begin = chunk * loop.grain;
+		const unsigned int end = (unsigned int)std::min((unsigned long long)begin + loop.grain, (unsigned long long)loop.count);
+		loop.run(loop.body, begin, end);
+		loop.chunksLeft.countDown();
+	}
+}
+
+void ThreadPool::workerLoop(const unsigned int index)
+{
+	t_pool = this;
+	t_workerIndex = index;
+	t_randomState = 0x9E3779B9u * (index + 1);
+
+	while (true)
+	{
+		TaskSlot* slot = findTask(index);
+		if (slot)
+		{
+			m_queuedTasks.fetch_sub(1, std::memory_order_relaxed);
+			runSlot(slot);
+			continue;
+		}
+
+		// If we're stopping and there is nothing left, exit.
+		if (!waitForTasks(index))
+			return;
+	}
+}
+
+bool ThreadPool::hasTasksOrStop() const
+{
+	return m_queuedTasks.load(std::memory_order_relaxed) > 0 || m_stop.load(std::memory_order_relaxed);
+}
+
+// Waits until there is a task to look for, or returns false if the pool is stopping and there are none left.
+// A sleeping thread takes tens of microseconds to wake, more than the gap between the jobs of one frame, so first it
+// spins with pause for up to twice the worker's average idle time (at most max_spin_microseconds), then yields a few
+// times, then sleeps. If tasks have been taking longer than max_spin_microseconds to turn up, spinning would just burn
+// the core, so it goes straight to yielding. The average starts at 0 and only takes in idle times up to
+// max_averaged_idle_microseconds - a longer one (the gap between frames, or no multi threaded method picked) says
+// nothing about the gaps between the jobs of a frame, and capping it instead would still drag the average up.
+bool ThreadPool::waitForTasks(const unsigned int index)
+{
+	using Clock = std::chrono::steady_clock;
+	WorkerQueue& queue = *m_queues[index];
+	const Clock::time_point idleStart = Clock::now();
+
+	const bool adaptiveSpin = m_adaptiveSpin.load(std::memory_order_relaxed);
+	bool found = hasTasksOrStop();
+	if (adaptiveSpin && !found && queue.averageIdleMicroseconds <= max_spin_microseconds)
+	{
+		const float spinMicroseconds = std::min(2.0f * queue.averageIdleMicroseconds, max_spin_microseconds);
+		const Clock::time_point spinEnd = idleStart + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float, std::micro>(spinMicroseconds));
+		for (unsigned int spins = 1; !(found = hasTasksOrStop()); spins++)
+		{
+			_mm_pause();
+			if (spins % 64 == 0 && Clock::now() >= spinEnd)
+				break;
+		}
+	}
+	for (unsigned int i = 0; adaptiveSpin && !found && i < yield_count; i++)
+	{
+		std::this_thread::yield();
+		found = hasTasksOrStop();
+	}
+
+	if (!found)
+	{
+		// Sleep until something is queued - registering first, so a task queued from here on either shows up in the
+		// check or wakes the wait
+		const EventCount::Key key = m_taskEvents.prepareWait();
+		if (hasTasksOrStop())
+			m_taskEvents.cancelWait();
+		else
+			m_taskEvents.wait(key);
+	}
+
+	if (m_stop.load() && m_queuedTasks.load() <= 0)
+		return false;
+
+	const float idleMicroseconds = std::chrono::duration<float, std::micro>(Clock::now() - idleStart).count();
+	if (idleMicroseconds <= max_averaged_idle_microseconds)
+		queue.averageIdleMicroseconds += idle_average_weight * (idleMicroseconds - queue.averageIdleMicroseconds);
+	return true;
+}
+
+// Runs the task and frees its slot for the worker that owns it
+void ThreadPool::runSlot(TaskSlot* slot)
+{
+	slot->task();
+	slot->task.reset();
+	slot->queued.store(false, std::memory_order_release);
+}
+
+ThreadPool::TaskSlot* ThreadPool::findTask(const unsigned int index)
+{
+	TaskSlot* slot = nullptr;
+	WorkStealingDeque<TaskSlot*>& deque = m_queues[index]->deque;
+	if (deque.pop(slot))
+		return slot;
+
+	if (takeInjectedTasks(index) && deque.pop(slot))
+		return slot;
+
+	return stealTask(index);
+}
+
+// Moves this worker's share of the injection queue on to its own deque (under one lock, for the locked queue), where the
+// other workers can steal them if it falls behind
+bool ThreadPool::takeInjectedTasks(const unsigned int index)
+{
+	const unsigned int waiting = injectedTaskCount();
+	if (waiting == 0)
+		return false;
+
+	// a task only comes off the queue once there is a free slot to put it in
+	const unsigned int share = waiting / (unsigned int)m_queues.size() + 1;
+	unsigned int moved = 0;
+	Task task;
+	if (m_lockFreeInjectedTasks)
+	{
+		while (moved < share && hasFreeSlot(index) && m_lockFreeInjectedTasks->pop(task))
+		{
+			pushLocal(index, std::move(task));
+			moved++;
+		}
+		return moved > 0;
+	}
+
+	std::unique_lock<std::mutex> lock(m_injectionMutex);
+	while (moved < share && hasFreeSlot(index) && m_injectedTasks->pop(task))
+	{
+		pushLocal(index, std::move(task));
+		moved++;
+	}
+	m_injectedCount.store(m_injectedTasks->size(), std::memory_order_relaxed);
+	return moved > 0;
+}
+
+// Tries every other worker's deque once, starting from a random one so thieves spread out over the victims
+ThreadPool::TaskSlot* ThreadPool::stealTask(const unsigned int index)
+{
+	const unsigned int numWorkers = (unsigned int)m_queues.size();
+	if (numWorkers < 2)
+		return nullptr;
+
+	// xorshift
+	t_randomState ^= t_randomState << 13;
+	t_randomState ^= t_randomState >> 17;
+	t_randomState ^= t_randomState << 5;
+	const unsigned int first = t_randomState % numWorkers;
+
+	TaskSlot* slot = nullptr;
+	for (unsigned int i = 0; i < numWorkers; i++)
+	{
+		const unsigned int victim = (first + i) % numWorkers;
+		if (victim != index && m_queues[victim]->deque.steal(slot))
+			return slot;
+	}
+	return nullptr;
+}
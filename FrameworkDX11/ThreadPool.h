@@ -11,87 +11,239 @@
 // The above copyright notice and this permission notice shall be included in all
 // copies or substantial portions of the Software.
 
-// A simple, fairly standard, thread pool
+// A work stealing thread pool. Each worker has its own deque (WorkStealingDeque.h) that it pushes and pops without
+// locks, and a worker with nothing to do steals from the deque of another worker picked at random. Tasks enqueued from
+// outside the pool go in to one shared injection queue, and a worker taking from it moves a share of them on to its own
+// deque, so a burst of small tasks costs one lock per batch rather than one per task. Tasks are kept inline (Task.h) in
+// fixed size rings - each worker's slots and the injection queue - so queueing one never allocates.
+// The injection queue is picked when the pool is made: a ring behind a mutex, or a lock free MPMC queue (MPMCQueue.h).
+// Either way idle workers sleep on an eventcount (EventCount.h), so queueing a task only takes a lock to wake one.
+// Before they sleep, workers spin for about as long as tasks have been taking to turn up (see waitForTasks), as waking a
+// sleeping thread costs more than the gap between the jobs of one frame.
 
 #pragma once
 #include <vector>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
-#include <queue>
-#include <functional>
 #include <memory>
+#include <atomic>
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <immintrin.h>
+#include "constants.h"
+#include "EventCount.h"
+#include "MPMCQueue.h"
+#include "Task.h"
+#include "WorkStealingDeque.h"
 
-class ThreadPool
+// Counts down to zero once, and wakes whoever is waiting on it. Counting down is one atomic op - only the last one takes
+// the lock, to wake the waiter - and a waiter only sleeps if the count isn't already zero. It has to outlive the last
+// countDown as well as the wait.
+class Latch
 {
 public:
-    ThreadPool() = default;
+    explicit Latch(const unsigned int count) : m_count(count) {}
 
-    ThreadPool(const unsigned int numThreads)
+    // Only once nothing else is using it
+    void reset(const unsigned int count) { m_count.store(count, std::memory_order_relaxed); }
+
+    void countDown()
     {
-        for (unsigned int i = 0; i < numThreads; ++i)
+        if (m_count.fetch_sub(1, std::memory_order_acq_rel) == 1)
         {
-            m_workers.emplace_back([this] {
-                while (true)
-                {
-                    std::function<void()> task;
-
-                    // The lock must be established before waiting
-                    std::unique_lock<std::mutex> lock(m_queueMutex);
-
-                    // The condition variable's wait function will atomically unlock the mutex
-                    // and suspend the thread. When woken, it re-acquires the lock.
-                    m_condition.wait(lock, [this] {
-                        return m_stop || !m_tasks.empty();
-                        });
-
-                    // If we woke up because we're stopping and the queue is empty, exit.
-                    if (m_stop && m_tasks.empty()) {
-                        return;
-                    }
-
-                    // Otherwise, a task must be available.
-                    task = std::move(m_tasks.front());
-                    m_tasks.pop();
-
-                    // Release the lock before executing the task
-                    lock.unlock();
-
-                    task();
-                }
-                });
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.notify_all();
         }
     }
 
-    unsigned int threadCount() { return m_workers.size(); }
+    bool tryWait() const { return m_count.load(std::memory_order_acquire) == 0; }
 
-    ~ThreadPool()
+    // Spins for up to spinMicroseconds before it sleeps - the last few jobs of a loop usually finish close together
+    void wait(const float spinMicroseconds = 0.0f)
     {
+        if (tryWait())
+            return;
+
+        if (spinMicroseconds > 0.0f)
         {
-            std::unique_lock<std::mutex> lock(m_queueMutex);
-            m_stop = true;
-        }
-        m_condition.notify_all();
-        for (std::thread& worker : m_workers)
-        {
-            worker.join();
+            const std::chrono::steady_clock::time_point spinEnd = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<float, std::micro>(spinMicroseconds));
+            for (unsigned int spins = 1; !tryWait(); spins++)
+            {
+                _mm_pause();
+                if (spins % 64 == 0 && std::chrono::steady_clock::now() >= spinEnd)
+                    break;
+            }
+            if (tryWait())
+                return;
         }
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_condition.wait(lock, [this] { return tryWait(); });
+    }
+
+private:
+    std::atomic<unsigned int>   m_count;
+    std::mutex                  m_mutex;
+    std::condition_variable     m_condition;
+};
+
+class ThreadPool
+{
+public:
+    ThreadPool() = default;
+    ThreadPool(const unsigned int numThreads, const int queueType = task_queue_locked);
+    ~ThreadPool();
+
+    unsigned int threadCount() { return m_workers.size(); }
+    int queueType() const { return m_queueType; }
+
+    // Off, idle workers go straight to sleep, and the wait for a parallelFor sleeps straight away
+    void setAdaptiveSpin(const bool spin) { m_adaptiveSpin.store(spin, std::memory_order_relaxed); }
+
+    // From a worker of this pool the task goes on that worker's own deque, from anywhere else on the injection queue.
+    // If that is full, or the pool has no workers, the task runs there and then, on the calling thread.
+    template <typename F>
+    void enqueue(F&& function)
+    {
+        enqueueTask(Task(std::forward<F>(function)));
+    }
+
+    // Split [0, count) in to jobCount nearly equal ranges, and give the range for this job
+    static void jobRange(const unsigned int count, const unsigned int jobCount, const unsigned int job, unsigned int& begin, unsigned int& end)
+    {
+        begin = (unsigned int)(((unsigned long long)count * job) / jobCount);
+        end = (unsigned int)(((unsigned long long)count * (job + 1)) / jobCount);
+    }
+
+    // Split the rows [0, count) of an upper triangle - row i has a pair with each of the count - 1 - i rows after it,
+    // as in the all pairs loops - in to jobCount ranges with nearly equal numbers of pairs, and give the range for this
+    // job. An equal number of rows would give the first job nearly twice its share and the last almost nothing.
+    static void triangleJobRange(const unsigned int count, const unsigned int jobCount, const unsigned int job, unsigned int& begin, unsigned int& end)
+    {
+        begin = triangleBoundary(count, jobCount, job);
+        end = triangleBoundary(count, jobCount, job + 1);
     }
 
-    void enqueue(std::function<void()> task)
+    // Run body(begin, end) over [0, count) in chunks of grain items, on the pool and the calling thread, and wait for
+    // them all to finish. The chunks are handed out in order to whichever thread asks next, so a thread that gets held
+    // up doesn't hold up the rest. The pool's helpers are queued in one go, and the wait only spins briefly before it sleeps.
+    // It can be called from inside a job - the caller works through the chunks itself, so it never waits on the queue.
+    template <typename Body>
+    void parallelFor(const unsigned int count, const unsigned int grain, const Body& body)
     {
+        const unsigned int chunkSize = std::max(grain, 1u);
+        const unsigned int chunkCount = (unsigned int)(((unsigned long long)count + chunkSize - 1) / chunkSize);
+        if (chunkCount < 2 || m_workers.empty())
         {
-            std::unique_lock<std::mutex> lock(m_queueMutex);
-            m_tasks.emplace(std::move(task));
+            if (count > 0)
+                body(0, count);
+            return;
         }
-        m_condition.notify_one();
+
+        runParallelFor(count, chunkSize, chunkCount, [](const void* loopBody, const unsigned int begin, const unsigned int end) {
+            (*static_cast<const Body*>(loopBody))(begin, end);
+            }, &body);
+    }
+
+    // Run job(0) .. job(jobCount - 1) on the pool and the calling thread, and wait for them all to finish
+    template <typename Job>
+    void runJobs(const unsigned int jobCount, const Job& job)
+    {
+        parallelFor(jobCount, 1, [&job](const unsigned int begin, const unsigned int end) {
+            for (unsigned int i = begin; i < end; i++)
+                job(i);
+            });
     }
 
 private:
-    std::vector<std::thread> m_workers;
-    std::queue<std::function<void()>> m_tasks;
-    std::mutex m_queueMutex;
-    std::condition_variable m_condition;
-    bool m_stop = false;
-};
+    // The first row of the job's range. The rows from there on are a smaller triangle holding (jobCount - job) / jobCount
+    // of the pairs, and m rows hold m (m - 1) / 2 pairs - so m is the root of m^2 - m - fraction * count (count - 1).
+    static unsigned int triangleBoundary(const unsigned int count, const unsigned int jobCount, const unsigned int job)
+    {
+        if (job >= jobCount)
+            return count;
+
+        const double fraction = (double)(jobCount - job) / jobCount;
+        const double rows = 0.5 + std::sqrt(0.25 + fraction * count * (count - 1.0));
+        return count - std::min(count, (unsigned int)(rows + 0.5));
+    }
+
+private:
+    static constexpr unsigned int local_task_capacity = 256;
+    static constexpr unsigned int injection_capacity = 4096;
+
+    // The worker wait policy - see waitForTasks
+    static constexpr float max_spin_microseconds = 50.0f;
+    static constexpr float idle_average_weight = 0.125f; // of each new idle time in the moving average
+    static constexpr float max_averaged_idle_microseconds = 2.0f * max_spin_microseconds; // longer idle times are left out
+    static constexpr unsigned int yield_count = 4;
+    static constexpr float latch_spin_microseconds = 20.0f;
 
+    // A queued task in one of a worker's slots. The worker hands out its slots in turn, and only reuses one once the
+    // task in it has run - on whichever thread took it.
+    struct TaskSlot
+    {
+        Task                task;
+        std::atomic<bool>   queued{ false };
+    };
+
+    struct WorkerQueue
+    {
+        WorkerQueue() : deque(local_task_capacity), slots(new TaskSlot[local_task_capacity]) {}
+
+        WorkStealingDeque<TaskSlot*>    deque; // never holds more than the slots, so it never has to grow
+        std::unique_ptr<TaskSlot[]>     slots;
+        unsigned int                    nextSlot = 0;
+        float                           averageIdleMicroseconds = 0.0f; // how long until a task turns up, over the short waits
+    };
+
+    // One parallelFor. The helper tasks share it with the caller, as one may only start once the loop is done - it then
+    // finds no chunks left and never touches the body. Each calling thread keeps its last one to use again, once no
+    // helper still has it.
+    struct ParallelLoop
+    {
+        unsigned int                count = 0;
+        unsigned int                grain = 1;
+        unsigned int                chunkCount = 0;
+        void                        (*run)(const void* body, const unsigned int begin, const unsigned int end) = nullptr;
+        const void*                 body = nullptr;
+        std::atomic<unsigned int>   nextChunk{ 0 };
+        Latch                       chunksLeft{ 0 };
+    };
+
+    void runParallelFor(const unsigned int count, const unsigned int grain, const unsigned int chunkCount, void (*run)(const void*, const unsigned int, const unsigned int), const void* body);
+    static void runChunks(ParallelLoop& loop);
+
+    void enqueueTask(Task&& task);
+    template <typename F>
+    unsigned int enqueueCopies(const F& function, const unsigned int copies);
+    bool pushLocal(const unsigned int index, Task&& task);
+    bool hasFreeSlot(const unsigned int index) const;
+    unsigned int injectedTaskCount() const;
+
+    void workerLoop(const unsigned int index);
+    bool waitForTasks(const unsigned int index);
+    bool hasTasksOrStop() const;
+    TaskSlot* findTask(const unsigned int index);
+    bool takeInjectedTasks(const unsigned int index);
+    TaskSlot* stealTask(const unsigned int index);
+    static void runSlot(TaskSlot* slot);
+
+    std::vector<std::thread>                    m_workers;
+    std::vector<std::unique_ptr<WorkerQueue>>   m_queues; // one per worker
+
+    // The injection queue - only the one for the pool's queue type is made
+    int                                 m_queueType = task_queue_locked;
+    std::unique_ptr<TaskRing>           m_injectedTasks;
+    std::mutex                          m_injectionMutex;
+    std::atomic<unsigned int>           m_injectedCount{ 0 }; // so workers can skip the lock when there is nothing there
+    std::unique_ptr<MPMCQueue<Task>>    m_lockFreeInjectedTasks;
+
+    // Tasks in any queue or deque, not yet taken. Workers only sleep when it is 0.
+    std::atomic<long long>              m_queuedTasks{ 0 };
+    EventCount                          m_taskEvents;
+    std::atomic<bool>                   m_stop{ false };
+    std::atomic<bool>                   m_adaptiveSpin{ true };
+};
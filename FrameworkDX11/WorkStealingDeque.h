@@ -0,0 +1,128 @@
+// MIT License
+// Copyright (c) 2025 David White
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// A Chase-Lev work stealing deque (with the memory orders from Le et al, "Correct and Efficient Work-Stealing for Weak
+// Memory Models"). The thread that owns it pushes and pops at the bottom without any locks, and other threads steal
+// from the top, so only a steal of the last item has to race the owner for it.
+// T has to be something that fits in an atomic, such as a pointer.
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+template <typename T>
+class WorkStealingDeque
+{
+public:
+    explicit WorkStealingDeque(const long long capacity = 256)
+    {
+        m_arrays.push_back(std::make_unique<Array>(capacity));
+        m_array.store(m_arrays.back().get(), std::memory_order_relaxed);
+    }
+
+    WorkStealingDeque(const WorkStealingDeque&) = delete;
+    WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+    // Owner only
+    void push(const T item)
+    {
+        const long long bottom = m_bottom.load(std::memory_order_relaxed);
+        const long long top = m_top.load(std::memory_order_acquire);
+        Array* array = m_array.load(std::memory_order_relaxed);
+        if (bottom - top > array->capacity() - 1)
+            array = grow(array, top, bottom);
+
+        // the paper has a release fence then a relaxed store - a release store is the same on x86, and sanitizers follow it
+        array->put(bottom, item);
+        m_bottom.store(bottom + 1, std::memory_order_release);
+    }
+
+    // Owner only - the last item pushed
+    bool pop(T& item)
+    {
+        const long long bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+        Array* array = m_array.load(std::memory_order_relaxed);
+        m_bottom.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        long long top = m_top.load(std::memory_order_relaxed);
+
+        if (top > bottom)
+        {
+            // it was empty
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+            return false;
+        }
+
+        item = array->get(bottom);
+        if (top == bottom)
+        {
+            // the last item, so a thief may be after it too - whoever moves top first has it
+            const bool won = m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+            return won;
+        }
+        return true;
+    }
+
+    // Any thread - the oldest item. Returns false if it was empty or another thread got there first.
+    bool steal(T& item)
+    {
+        long long top = m_top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const long long bottom = m_bottom.load(std::memory_order_acquire);
+        if (top >= bottom)
+            return false;
+
+        const Array* array = m_array.load(std::memory_order_acquire);
+        item = array->get(top);
+        return m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+    }
+
+    // Only a hint when other threads are using it
+    bool empty() const
+    {
+        return m_bottom.load(std::memory_order_relaxed) <= m_top.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Array
+    {
+        explicit Array(const long long capacity) : m_mask(capacity - 1), m_items(new std::atomic<T>[capacity]) {}
+
+        long long capacity() const { return m_mask + 1; }
+        T get(const long long i) const { return m_items[i & m_mask].load(std::memory_order_relaxed); }
+        void put(const long long i, const T item) { m_items[i & m_mask].store(item, std::memory_order_relaxed); }
+
+        const long long                     m_mask; // the capacity is a power of two
+        std::unique_ptr<std::atomic<T>[]>   m_items;
+    };
+
+    Array* grow(const Array* array, const long long top, const long long bottom)
+    {
+        m_arrays.push_back(std::make_unique<Array>(array->capacity() * 2));
+        Array* bigger = m_arrays.back().get();
+        for (long long i = top; i < bottom; i++)
+            bigger->put(i, array->get(i));
+
+        m_array.store(bigger, std::memory_order_release);
+        return bigger;
+    }
+
+    // top and bottom on their own cache lines, as thieves write one and the owner the other
+    alignas(64) std::atomic<long long>  m_top{ 0 };
+    alignas(64) std::atomic<long long>  m_bottom{ 0 };
+    std::atomic<Array*>                 m_array{ nullptr };
+    std::vector<std::unique_ptr<Array>> m_arrays; // the old arrays are kept, as a thief may still be reading one
+};
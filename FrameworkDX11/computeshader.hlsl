@@ -1,10 +1,30 @@
 
+// The collision test - ColliderManager compiles a version of this shader for each (the values match constants.h)
+#define PREDICATE_AABB 0
+#define PREDICATE_SPHERE 1
+#define PREDICATE_FIRST_HIT 2 // sphere, but only record the first collision per box
+
+#ifndef PREDICATE
+#define PREDICATE PREDICATE_FIRST_HIT
+#endif
+
 struct Box
 {
     float4 positionAndRadius;
     float4 velocity;
 };
 
+// The node layout of the CPU linear BVH (LBVHNode in LBVH.h) - the two must match so a GPU build / traversal
+// can share buffers with the CPU version. Internal nodes come first, then the leaves.
+// Internal: left / right are child node indices. Leaf: left is -1 and right is the box index.
+struct LBVHNode
+{
+    float3 aabbMin;
+    int left;
+    float3 aabbMax;
+    int right;
+};
+
 
 
 // A read-only structured buffer for the box data
@@ -34,6 +54,10 @@ void main(uint3 dispatchThreadID : SV_DispatchThreadID)
         return;
     }
 
+    // The size of the results buffer - the counter keeps counting past it, but nothing is written
+    uint maxPairs = 0;
+    CollisionPairs.GetDimensions(maxPairs, stride);
+
     // Loop through all subsequent boxes to form unique pairs
     for (uint j = i + 1; j < numBoxes; j++)
     {
@@ -44,20 +68,28 @@ void main(uint3 dispatchThreadID : SV_DispatchThreadID)
         float radius_j = Boxes[j].positionAndRadius.w;
 
         // Perform the box-box collision test
-        float distSq = dot(pos_i - pos_j, pos_i - pos_j);
         float sumRadii = radius_i + radius_j;
+#if PREDICATE == PREDICATE_AABB
+        bool collides = all(abs(pos_i - pos_j) < sumRadii);
+#else
+        float distSq = dot(pos_i - pos_j, pos_i - pos_j);
+        bool collides = distSq < (sumRadii * sumRadii);
+#endif
 
         InterlockedAdd(AtomicCounter[1], 1);
         
-        if (distSq < (sumRadii * sumRadii))
+        if (collides)
         {
             // If they collide, atomically increment the counter to get a write index
             uint write_index;
             InterlockedAdd(AtomicCounter[0], 1, write_index);
 
             // Write the indices of the colliding pair to the results buffer
-            CollisionPairs[write_index] = uint2(i, j);
+            if (write_index < maxPairs)
+                CollisionPairs[write_index] = uint2(i, j);
+#if PREDICATE == PREDICATE_FIRST_HIT
             break; // only record 1 collision per box
+#endif
         }
     }
 }
\ No newline at end of file
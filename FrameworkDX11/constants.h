@@ -8,5 +8,28 @@ constexpr int max_number_of_boxes = 20000;
 constexpr int use_cpu_singlethread = 0;
 constexpr int use_cpu_multithread = 1;
 constexpr int use_gpu = 2;
+constexpr int use_cpu_grid = 3;
+constexpr int use_cpu_sap = 4;
+constexpr int use_cpu_aabb_tree = 5;
+constexpr int use_cpu_lbvh = 6;
+constexpr int use_cpu_cell_list = 7;
+constexpr int use_cpu_neighbour_list = 8;
+constexpr int use_cpu_hierarchical_grid = 9;
+constexpr int use_gpu_emulated = 10; // the compute shader, run on the CPU
 
 constexpr int use_method = use_gpu;
+
+// The collision test - the values are also the PREDICATE define in computeshader.hlsl
+constexpr int predicate_per_method = -1; // each method's own test: AABB single threaded, sphere multi threaded, first hit on the GPU
+constexpr int predicate_aabb = 0;
+constexpr int predicate_sphere = 1;
+constexpr int predicate_first_hit = 2; // sphere, but only the first box each box hits (as the compute shader was written)
+constexpr int predicate_count = 3;
+
+// The space-filling curve ColliderManager sorts the boxes along (see SpaceFillingCurve.h)
+constexpr int curve_morton = 0;
+constexpr int curve_hilbert = 1;
+
+// The queue ThreadPool puts tasks from outside the pool in to
+constexpr int task_queue_locked = 0; // a ring buffer behind a mutex
+constexpr int task_queue_lock_free = 1; // Vyukov's bounded MPMC queue (MPMCQueue.h)
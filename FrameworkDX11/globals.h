@@ -4,3 +4,26 @@
 
 inline int g_ttype = 2;
 inline int g_cube_count = 2000;
+inline bool g_mixed_box_sizes = false;
+inline bool g_tiled_all_pairs = false;
+inline bool g_simd_kernels = true;
+inline const char* g_simd_kernels_name = "scalar"; // set by ColliderManager::init
+inline int g_predicate = predicate_per_method;
+inline bool g_batched_resolve = false; // resolve pairs that share no box a register at a time, where the kernels can
+inline bool g_exact_resolve = true; // the batched resolve gives the same velocities as resolving one pair at a time
+inline int g_all_pairs_chunks_per_thread = 8; // the multi threaded all pairs loop is split in to this many chunks per thread
+inline int g_task_queue = task_queue_locked; // the thread pool's queue for tasks from outside it
+inline bool g_adaptive_spin = true; // idle workers spin a little before they sleep
+inline bool g_parallel_movement = true; // the movement update is split across the thread pool, with enough boxes
+inline bool g_compact_boxes = false; // the all pairs CPU loops use the 16 bit quantized boxes (CompactBoxes.h)
+inline int g_reorder_interval = 0; // the boxes are sorted along a space-filling curve every this many frames, 0 for never
+inline int g_reorder_curve = curve_hilbert;
+
+// What the last collision update did, for the UI - so timings can say which collision test they measured
+struct CollisionStats
+{
+    const char* predicate = "";
+    unsigned int pairCount = 0;
+    bool uniformRadius = false; // the all pairs row kernels used their version for boxes that are all one size
+};
+inline CollisionStats g_collision_stats;
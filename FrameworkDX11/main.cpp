@@ -2,8 +2,6 @@
 // File: main.cpp
 //
 
-#define _XM_NO_INTRINSICS_ // no platform specific intrinsics
-
 #include "main.h"
 #include "constants.h"
 #include "Camera.h"
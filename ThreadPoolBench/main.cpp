@@ -0,0 +1,248 @@
+// ThreadPoolBench - a stress test and latency benchmark for ThreadPool, run on both of its injection queues
+// (task_queue_locked and task_queue_lock_free), and of how fast idle workers pick up a task with their spin before
+// they sleep on and off. Build it in Release and run it outside the debugger:
+//     ThreadPoolBench [workers]
+// The pool has one worker per hardware thread by default, as in ColliderManager. It returns 1 if the stress test fails.
+
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+// The producer counts, as in the request for the MPMC queue
+static const unsigned int producer_counts[] = { 16, 32, 64 };
+
+constexpr unsigned int stress_tasks_per_producer = 20000;
+constexpr unsigned int stress_child_every = 8; // every this many tasks also queue one from inside the pool
+constexpr unsigned int stress_loop_every = 1000; // and the producer runs a parallelFor
+constexpr unsigned int stress_loop_count = 1000;
+
+// Each producer queues a burst, waits for it to finish, and goes again - 64 producers' bursts still fit in the
+// injection queue, so the latencies are queueing and waking up. A task only runs on its producer if the queue looks
+// full anyway: the lock free one does when a worker stalls part way through taking a task and the ring wraps round to it.
+constexpr unsigned int latency_burst = 32;
+constexpr unsigned int latency_bursts_per_producer = 64;
+
+// One thread queueing one task at a time, as the main thread queues the jobs of a frame, with a pause between each
+// task finishing and the next being queued - so the workers are idle in between, and the time to start the next one is
+// the time to catch it: spinning, or waking up from sleep
+static const float dispatch_gaps_microseconds[] = { 5, 20, 100, 1000 };
+constexpr unsigned int dispatch_tasks = 2000;
+
+static thread_local bool t_producer = false;
+
+static const char* queueName(const int queueType)
+{
+	return queueType == task_queue_lock_free ? "lock free" : "locked";
+}
+
+static double microsecondsSince(const Clock::time_point start)
+{
+	return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+static void waitMicroseconds(const float microseconds)
+{
+	const Clock::time_point start = Clock::now();
+	while (microsecondsSince(start) < microseconds)
+		_mm_pause();
+}
+
+static float percentile(std::vector<float>& samples, const double fraction)
+{
+	std::sort(samples.begin(), samples.end());
+	return samples[std::min((size_t)(samples.size() * fraction), samples.size() - 1)];
+}
+
+// The shared state of a stress run. Every task has its own counter, so a task that is lost or run twice shows up.
+struct StressRun
+{
+	explicit StressRun(const unsigned int taskCount) : taskRuns(taskCount), childRuns(taskCount) {}
+
+	std::vector<std::atomic<unsigned int>>  taskRuns;
+	std::vector<std::atomic<unsigned int>>  childRuns;
+	std::atomic<long long>                  pending{ 0 };
+	std::atomic<unsigned long long>         loopSum{ 0 };
+};
+
+// producers threads each queue stress_tasks_per_producer tasks at once. Some of the tasks queue another from inside the
+// pool (the worker's own deque), and now and then a producer runs a parallelFor, whose helpers go through
+// enqueueCopies. Returns true if every task ran exactly once and every loop covered its range.
+static bool stressTest(const int queueType, const unsigned int workers, const unsigned int producers)
+{
+	ThreadPool pool(workers, queueType);
+	const unsigned int taskCount = producers * stress_tasks_per_producer;
+	StressRun run(taskCount);
+
+	const Clock::time_point start = Clock::now();
+	std::vector<std::thread> threads;
+	for (unsigned int p = 0; p < producers; p++)
+	{
+		threads.emplace_back([&pool, &run, p] {
+			for (unsigned int i = 0; i < stress_tasks_per_producer; i++)
+			{
+				const unsigned int task = p * stress_tasks_per_producer + i;
+				run.pending.fetch_add(1);
+				pool.enqueue([&pool, &run, task] {
+					if (task % stress_child_every == 0)
+					{
+						run.pending.fetch_add(1);
+						pool.enqueue([&run, task] {
+							run.childRuns[task].fetch_add(1);
+							run.pending.fetch_sub(1);
+							});
+					}
+					run.taskRuns[task].fetch_add(1);
+					run.pending.fetch_sub(1);
+					});
+
+				if (i % stress_loop_every == 0)
+				{
+					pool.parallelFor(stress_loop_count, 16, [&run](const unsigned int begin, const unsigned int end) {
+						unsigned long long sum = 0;
+						for (unsigned int k = begin; k < end; k++)
+							sum += k;
+						run.loopSum.fetch_add(sum);
+						});
+				}
+			}
+			});
+	}
+	for (std::thread& thread : threads)
+		thread.join();
+	while (run.pending.load() > 0)
+		std::this_thread::yield();
+
+	unsigned int lost = 0;
+	unsigned int repeated = 0;
+	for (unsigned int task = 0; task < taskCount; task++)
+	{
+		const unsigned int childExpected = task % stress_child_every == 0 ? 1 : 0;
+		lost += (run.taskRuns[task] == 0) + (run.childRuns[task] < childExpected);
+		repeated += (run.taskRuns[task] > 1) + (run.childRuns[task] > childExpected);
+	}
+	const unsigned long long loops = (unsigned long long)producers * ((stress_tasks_per_producer + stress_loop_every - 1) / stress_loop_every);
+	const bool loopsOk = run.loopSum == loops * stress_loop_count * (stress_loop_count - 1) / 2;
+
+	const bool ok = lost == 0 && repeated == 0 && loopsOk;
+	printf("  %-9s  %2u producers  %s  (%u lost, %u run twice, parallelFor sums %s)  %.1f ms\n", queueName(queueType), producers,
+		ok ? "ok  " : "FAIL", lost, repeated, loopsOk ? "ok" : "wrong", microsecondsSince(start) / 1000.0);
+	return ok;
+}
+
+// The time from each task being queued to it starting on a worker, over producers threads queueing bursts of tasks at
+// once. Also the mean cost of the enqueue call itself, and how many tasks found the queue full and ran on their producer.
+static void latencyBenchmark(const int queueType, const unsigned int workers, const unsigned int producers)
+{
+	ThreadPool pool(workers, queueType);
+	const unsigned int taskCount = producers * latency_burst * latency_bursts_per_producer;
+	std::vector<float> latencies(taskCount);
+	std::atomic<unsigned int> inlineRuns{ 0 };
+	std::atomic<unsigned long long> enqueueNanoseconds{ 0 };
+
+	const Clock::time_point start = Clock::now();
+	std::vector<std::thread> threads;
+	for (unsigned int p = 0; p < producers; p++)
+	{
+		threads.emplace_back([&, p] {
+			t_producer = true;
+			std::atomic<unsigned int> burstLeft{ 0 };
+			unsigned long long enqueueTime = 0;
+			for (unsigned int burst = 0; burst < latency_bursts_per_producer; burst++)
+			{
+				burstLeft.store(latency_burst);
+				float* burstLatencies = &latencies[(p * latency_bursts_per_producer + burst) * latency_burst];
+				for (unsigned int i = 0; i < latency_burst; i++)
+				{
+					const Clock::time_point queued = Clock::now();
+					pool.enqueue([queued, latency = burstLatencies + i, &burstLeft, &inlineRuns] {
+						*latency = (float)microsecondsSince(queued);
+						if (t_producer)
+							inlineRuns.fetch_add(1, std::memory_order_relaxed);
+						burstLeft.fetch_sub(1, std::memory_order_release);
+						});
+					enqueueTime += (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - queued).count();
+				}
+				while (burstLeft.load(std::memory_order_acquire) > 0)
+					std::this_thread::yield();
+			}
+			enqueueNanoseconds.fetch_add(enqueueTime);
+			});
+	}
+	for (std::thread& thread : threads)
+		thread.join();
+	const double seconds = microsecondsSince(start) / 1e6;
+
+	printf("  %-9s  %2u producers  enqueue %6.0f ns   start p50 %8.1f us  p99 %8.1f us  max %9.1f us   %5.2f M tasks/s  %u inline\n",
+		queueName(queueType), producers, (double)enqueueNanoseconds.load() / taskCount,
+		percentile(latencies, 0.5), percentile(latencies, 0.99), percentile(latencies, 1.0), taskCount / seconds / 1e6, inlineRuns.load());
+}
+
+// The time from queueing a task to it starting on a worker, and the time a whole parallelFor with a chunk for each thread
+// and nothing to do takes, after a pause of gap microseconds with nothing queued - with the workers' spin before they sleep
+// on or off (ThreadPool::setAdaptiveSpin, the 'Workers spin before they sleep' option in the app)
+static void dispatchLatency(const unsigned int workers, const bool adaptiveSpin, const float gap)
+{
+	ThreadPool pool(workers);
+	pool.setAdaptiveSpin(adaptiveSpin);
+	std::vector<float> startLatencies(dispatch_tasks);
+	std::vector<float> loopTimes(dispatch_tasks);
+
+	for (unsigned int i = 0; i < dispatch_tasks; i++)
+	{
+		std::atomic<bool> done{ false };
+		waitMicroseconds(gap);
+		const Clock::time_point queued = Clock::now();
+		pool.enqueue([queued, latency = &startLatencies[i], &done] {
+			*latency = (float)microsecondsSince(queued);
+			done.store(true, std::memory_order_release);
+			});
+		while (!done.load(std::memory_order_acquire))
+			std::this_thread::yield();
+	}
+
+	// the caller takes a chunk too, so this is one for every worker
+	const unsigned int chunks = workers + 1;
+	for (unsigned int i = 0; i < dispatch_tasks; i++)
+	{
+		waitMicroseconds(gap);
+		const Clock::time_point start = Clock::now();
+		pool.parallelFor(chunks, 1, [](const unsigned int, const unsigned int) {});
+		loopTimes[i] = (float)microsecondsSince(start);
+	}
+
+	printf("  spin %-3s  gap %6.0f us   task start p50 %7.1f us  p99 %7.1f us   parallelFor p50 %7.1f us  p99 %7.1f us\n",
+		adaptiveSpin ? "on" : "off", gap, percentile(startLatencies, 0.5), percentile(startLatencies, 0.99),
+		percentile(loopTimes, 0.5), percentile(loopTimes, 0.99));
+}
+
+int main(int argc, char* argv[])
+{
+	unsigned int workers = argc > 1 ? (unsigned int)atoi(argv[1]) : std::thread::hardware_concurrency();
+	if (workers == 0)
+		workers = 1;
+	printf("ThreadPool with %u workers, %u hardware threads\n", workers, std::thread::hardware_concurrency());
+
+	const int queueTypes[] = { task_queue_locked, task_queue_lock_free };
+
+	printf("\nStress - every task run exactly once\n");
+	bool ok = true;
+	for (const int queueType : queueTypes)
+		for (const unsigned int producers : producer_counts)
+			ok = stressTest(queueType, workers, producers) && ok;
+
+	printf("\nEnqueue to start latency - bursts of %u tasks per producer\n", latency_burst);
+	for (const unsigned int producers : producer_counts)
+		for (const int queueType : queueTypes)
+			latencyBenchmark(queueType, workers, producers);
+
+	printf("\nDispatch latency - one thread queueing, after a gap with nothing queued\n");
+	for (const float gap : dispatch_gaps_microseconds)
+		for (const bool adaptiveSpin : { true, false })
+			dispatchLatency(workers, adaptiveSpin, gap);
+
+	return ok ? 0 : 1;
+}